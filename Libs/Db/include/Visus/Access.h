@@ -50,8 +50,20 @@ class VISUS_DB_API AccessStatistics
 {
 public:
 
-  Int64 rok = 0, rfail = 0;
-  Int64 wok = 0, wfail = 0;
+  VISUS_NON_COPYABLE_CLASS(AccessStatistics)
+
+  //NOTE: counters can be incremented by multiple reader threads (see IdxDiskAccess nthreads)
+#if SWIG
+  Int64 rok, rfail;
+  Int64 wok, wfail;
+#else
+  std::atomic<Int64> rok, rfail;
+  std::atomic<Int64> wok, wfail;
+#endif
+
+  //constructor
+  AccessStatistics() : rok(0), rfail(0), wok(0), wfail(0) {
+  }
 
   //reset
   void reset()
@@ -163,6 +175,18 @@ public:
   //writeBlock
   virtual void writeBlock(SharedPtr<BlockQuery> query) = 0;
 
+  //readBlocks (an access can override it to coalesce reads of adjacent blocks, by default blocks are read one at a time)
+  virtual void readBlocks(std::vector< SharedPtr<BlockQuery> > queries) {
+    for (auto query : queries)
+      readBlock(query);
+  }
+
+  //writeBlocks (an access can override it to encode blocks in parallel, by default blocks are written one at a time)
+  virtual void writeBlocks(std::vector< SharedPtr<BlockQuery> > queries) {
+    for (auto query : queries)
+      writeBlock(query);
+  }
+
   //beginRead
   void beginRead() {
     beginIO('r');
@@ -199,15 +223,15 @@ public:
 
   //resetStatistics
   void resetStatistics() {
-    statistics=Statistics();
+    statistics.reset();
   }
 
   //printStatistics
   virtual void printStatistics() 
   {
     PrintInfo("type", typeid(*this).name(), "chmod", can_read ? "r" : "", can_write ? "w" : "", "bitsperblock", bitsperblock);
-    PrintInfo("rok", statistics.rok, "rfail", statistics.rfail);
-    PrintInfo("wok", statistics.wok, "wfail", statistics.wfail);
+    PrintInfo("rok", (Int64)statistics.rok, "rfail", (Int64)statistics.rfail);
+    PrintInfo("wok", (Int64)statistics.wok, "wfail", (Int64)statistics.wfail);
   }
 
   //write
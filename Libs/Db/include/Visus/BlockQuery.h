@@ -84,6 +84,14 @@ public:
   int          H = 0;
   LogicSamples logic_samples;
 
+  //if true the access can skip decoding and return the block as stored (i.e. fill encoded instead of buffer)
+  bool                  accept_encoded = false;
+
+  //encoded block (see accept_encoded, only some accesses support it, for example IdxDiskAccess)
+  SharedPtr<HeapMemory> encoded;
+  String                encoded_compression;
+  String                encoded_layout;
+
   //constructor
   BlockQuery() {
   }
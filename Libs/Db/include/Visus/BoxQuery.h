@@ -106,6 +106,19 @@ public:
   std::function<void(Array)> incrementalPublish;
 #endif
 
+  //progressive refinement in place (see Dataset::executeBoxQuery)
+  //the final resolution buffer is allocated only once and each level merges only its new samples
+  //'buffer' is a copy of the samples of the current level (the final level shares the memory)
+#if !SWIG
+  struct
+  {
+    bool                     enabled = false;
+    LogicSamples             logic_samples;
+    Array                    buffer;
+  }
+  inplace;
+#endif
+
   //internal use only
 
   //constructor
@@ -162,6 +175,11 @@ public:
     this->filter.enabled = true;
   }
 
+  //enableInPlaceProgression (must be called before beginBoxQuery)
+  void enableInPlaceProgression() {
+    this->inplace.enabled = true;
+  }
+
 };
 
 
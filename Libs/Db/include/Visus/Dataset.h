@@ -386,6 +386,9 @@ public:
   //readBlock  
   virtual void executeBlockQuery(SharedPtr<Access> access, SharedPtr<BlockQuery> query);
 
+  //executeBlockQueries (read block queries are passed all together to the access, so that it can coalesce them)
+  virtual void executeBlockQueries(SharedPtr<Access> access, std::vector< SharedPtr<BlockQuery> > queries);
+
   //executeBlockQueryAndWait
   bool executeBlockQueryAndWait(SharedPtr<Access> access, SharedPtr<BlockQuery> query) {
     executeBlockQuery(access, query);
@@ -444,6 +447,9 @@ public:
   //executeBoxQueryOnServer
   virtual bool executeBoxQueryOnServer(SharedPtr<BoxQuery> query);
 
+  //executeBoxQueryInPlace
+  virtual bool executeBoxQueryInPlace(SharedPtr<Access> access, SharedPtr<BoxQuery> query);
+
 public:
 
   //________________________________________________
@@ -497,6 +503,9 @@ public:
   //computeFilter
   virtual bool computeFilter(SharedPtr<IdxFilter> filter, double time, Field field, SharedPtr<Access> access, PointNi SlidingWindow, bool bVerbose = false);
 
+  //computeFilterPyramid (all the levels fitting in a tile are computed in memory with one read/write of the tile, tiles run in parallel)
+  virtual bool computeFilterPyramid(SharedPtr<IdxFilter> filter, double time, Field field, Int64 max_tile_samples, bool bVerbose = false);
+
   //computeFilter
   virtual void computeFilter(const Field& field, int window_size, bool bVerbose = false);
 
@@ -97,9 +97,15 @@ public:
   //readBlock 
   virtual void readBlock(SharedPtr<BlockQuery> query) override;
 
+  //readBlocks (blocks are grouped by file, and reads of adjacent blocks coalesced)
+  virtual void readBlocks(std::vector< SharedPtr<BlockQuery> > queries) override;
+
   //writeBlock
   virtual void writeBlock(SharedPtr<BlockQuery> query) override;
 
+  //writeBlocks (blocks are encoded in parallel, then written one file at a time)
+  virtual void writeBlocks(std::vector< SharedPtr<BlockQuery> > queries) override;
+
   //endIO
   virtual void endIO() override;
 
@@ -109,13 +115,40 @@ public:
   //releaseWriteLock
   virtual void releaseWriteLock(SharedPtr<BlockQuery> query) override;
 
+  //getNumberOfThreads (number of async readers)
+  int getNumberOfThreads() const {
+    return async_tpool ? (int)async.size() : 0;
+  }
+
+  //getDictionaryFilename (compression dictionary of a field, stored alongside the dataset)
+  static String getDictionaryFilename(String idx_filename, Field field);
+
+  //getCompressionSpecs (adds the dictionary of the field if any, example "zstd-19" -> "zstd-19-dict=<md5>")
+  String getCompressionSpecs(Field field, String compression) const;
+
 private:
 
-  UniquePtr<Access>     sync, async;
-  SharedPtr<ThreadPool> async_tpool;
-  IdxFile               idxfile;
-  bool                  bSkipReading = false;
-  bool                  bSkipWriting = false;
+  UniquePtr<Access>                 sync;
+  std::vector< SharedPtr<Access> >  async;
+  SharedPtr<ThreadPool>             async_tpool;
+  IdxFile                           idxfile;
+  bool                              bSkipReading = false;
+  bool                              bSkipWriting = false;
+  int                               write_nthreads = 1;
+  SharedPtr<ThreadPool>             write_tpool;
+
+  //field name -> name of the dictionary in Encoders
+  std::map<String, String>          dictionaries;
+
+  //each async reader keeps its own file handle/headers, I try to give a worker the reader which has the file already open
+  CriticalSection                   async_lock;
+  std::vector< std::pair<Access*, String> > async_idle;
+
+  //acquireAsyncReader
+  Access* acquireAsyncReader(String filename);
+
+  //releaseAsyncReader
+  void releaseAsyncReader(Access* reader, String filename);
 
 }; 
 
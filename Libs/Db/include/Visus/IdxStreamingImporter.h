@@ -0,0 +1,199 @@
+/*-----------------------------------------------------------------------------
+Copyright(c) 2010 - 2018 ViSUS L.L.C.,
+Scientific Computing and Imaging Institute of the University of Utah
+
+ViSUS L.L.C., 50 W.Broadway, Ste. 300, 84101 - 2044 Salt Lake City, UT
+University of Utah, 72 S Central Campus Dr, Room 3750, 84112 Salt Lake City, UT
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met :
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+For additional information about this project contact : pascucci@acm.org
+For support : support@visus.net
+-----------------------------------------------------------------------------*/
+
+#ifndef __VISUS_DB_IDX_STREAMING_IMPORTER_H
+#define __VISUS_DB_IDX_STREAMING_IMPORTER_H
+
+#include <Visus/Db.h>
+#include <Visus/Array.h>
+#include <Visus/Field.h>
+#include <Visus/ThreadPool.h>
+#include <Visus/Time.h>
+#include <Visus/File.h>
+
+#include <map>
+#include <set>
+
+namespace Visus {
+
+//predeclaration
+class IdxDataset;
+class IdxDiskAccess;
+class BlockQuery;
+
+/*
+Writes a brand new IDX field consuming the input slab by slab (i.e. slices along the last axis, in order)
+without ever holding the whole volume in memory.
+
+Each slab is scattered directly into the hz blocks it intersects (in parallel); as soon as the slabs have covered
+the whole extent of a block along the last axis, the block is complete and it's flushed to disk (encoding is done
+in parallel by IdxDiskAccess::writeBlocks). Fine blocks complete quickly, coarse blocks live until the end: when 
+the partially filled blocks exceed max_memory, the raw samples of the coarsest ones are spilled to a scratch file 
+(next to the .idx, removed by endImport) and read back when needed. Blocks are encoded only once, when complete.
+*/
+
+//////////////////////////////////////////////////////////////////////////////
+class VISUS_DB_API IdxStreamingImporter
+{
+public:
+
+  VISUS_NON_COPYABLE_CLASS(IdxStreamingImporter)
+
+  //max bytes of partially filled blocks kept in memory (0 means no limit)
+  Int64 max_memory = 0;
+
+  //number of threads merging a slab into its blocks (0 means hardware_concurrency, see also VISUS_IMPORT_NTHREADS)
+  int nthreads = 0;
+
+  //print throughput every few seconds
+  bool bVerbose = true;
+
+  //constructor (empty compression means field.default_compression; one spec per level like compressDataset otherwise)
+  IdxStreamingImporter(IdxDataset* db, Field field, double time, std::vector<String> compression = std::vector<String>());
+
+  //destructor
+  virtual ~IdxStreamingImporter();
+
+  //getField
+  const Field& getField() const {
+    return field;
+  }
+
+  //getSlabDims (dims of a slab with <nslices> slices)
+  PointNi getSlabDims(Int64 nslices) const;
+
+  //getNextSlice (first slice, along the last axis, expected by the next importSlab)
+  Int64 getNextSlice() const {
+    return next_slice;
+  }
+
+  //getRemainingSlices
+  Int64 getRemainingSlices() const {
+    return logic_box.p2[axis] - next_slice;
+  }
+
+  //isComplete
+  bool isComplete() const {
+    return getRemainingSlices() == 0;
+  }
+
+  //getNumberOfSpilledBlocks (statistics, a block spilled twice counts twice)
+  Int64 getNumberOfSpilledBlocks() const {
+    return nspilled;
+  }
+
+  //beginImport
+  void beginImport();
+
+  //importSlab (dims must be getSlabDims(nslices), slabs must arrive in order)
+  void importSlab(Array slab);
+
+  //endImport
+  void endImport();
+
+  //importArray (split an in-memory array in slabs of about <slab_size> bytes)
+  static void importArray(IdxDataset* db, Array data, std::vector<String> compression = std::vector<String>(), Int64 slab_size = 64 * 1024 * 1024);
+
+private:
+
+  IdxDataset*                             db;
+  Field                                   field;
+  double                                  time;
+  std::vector<String>                     compression;
+  BoxNi                                   logic_box;
+  int                                     axis = 0;
+  Int64                                   next_slice = 0;
+  SharedPtr<IdxDiskAccess>                access;
+  SharedPtr<ThreadPool>                   tpool;
+  std::map<BigInt, SharedPtr<BlockQuery> > pending;
+  Int64                                   pending_bytes = 0;
+
+  //spilled blocks (each block always goes to the same slot of the scratch file, since blocks have a fixed size)
+  class Spilled
+  {
+  public:
+    Int64  offset = 0;
+    String layout;
+    bool   bInFile = false;
+  };
+
+  String                                  spill_filename;
+  File                                    spill_file;
+  std::map<BigInt, Spilled>               spilled;
+  Int64                                   spill_size = 0;
+
+  //statistics
+  Time                                    t1, last_print;
+  Int64                                   nbytes_in = 0;
+  Int64                                   nwritten = 0;
+  Int64                                   nspilled = 0;
+  Int64                                   peak_bytes = 0;
+
+  //createBlock
+  SharedPtr<BlockQuery> createBlock(BigInt blockid);
+
+  //isBlockComplete
+  bool isBlockComplete(SharedPtr<BlockQuery> block) const;
+
+  //writeBlocks
+  void writeBlocks(std::vector< SharedPtr<BlockQuery> > blocks);
+
+  //isSpilled
+  bool isSpilled(BigInt blockid) const {
+    auto it = spilled.find(blockid);
+    return it != spilled.end() && it->second.bInFile;
+  }
+
+  //spillBlocks
+  void spillBlocks(std::vector< SharedPtr<BlockQuery> > blocks);
+
+  //reloadBlocks
+  void reloadBlocks(std::vector< SharedPtr<BlockQuery> > blocks);
+
+  //closeSpillFile
+  void closeSpillFile();
+
+  //printStatistics
+  void printStatistics(String msg);
+
+};
+
+} //namespace Visus
+
+#endif //__VISUS_DB_IDX_STREAMING_IMPORTER_H
+
@@ -46,6 +46,28 @@ namespace Visus {
 
 class Dataset;
 
+//////////////////////////////////////////////////////////////////////////////////////////
+class VISUS_DB_API RamAccessStatistics
+{
+public:
+
+  //_______________________________________________
+  class Level
+  {
+  public:
+    int   H = 0;
+    Int64 hits = 0, misses = 0, evictions = 0, used = 0;
+  };
+
+  String             policy;
+  Int64              hits = 0, misses = 0, evictions = 0;
+  Int64              used = 0, available = 0;
+
+  //only levels with some activity
+  std::vector<Level> levels;
+
+};
+
 //////////////////////////////////////////////////////////////////////////////////////////
 class VISUS_DB_API RamAccess : public Access
 {
@@ -59,8 +81,9 @@ public:
   //destructor
   virtual ~RamAccess();
 
-  //setAvailableMemory
-  void setAvailableMemory(Int64 value);
+  //setAvailableMemory (memory is split among `nshards` independent caches, each one with its own lock)
+  //policy can be "lru", "clock", "2q" (or "arc"), "level" (evicts fine levels before coarse levels) 
+  void setAvailableMemory(Int64 value, int nshards = 16, String policy = "lru");
 
   //shareMemoryWith
   void shareMemoryWith(SharedPtr<RamAccess> value);
@@ -71,6 +94,12 @@ public:
   //writeBlock
   virtual void writeBlock(SharedPtr<BlockQuery> query) override;
 
+  //getCacheStatistics (shared by all the RamAccess sharing the same memory)
+  RamAccessStatistics getCacheStatistics() const;
+
+  //resetCacheStatistics
+  void resetCacheStatistics();
+
   //printStatistics
   virtual void printStatistics() override;
 
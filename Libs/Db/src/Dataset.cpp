@@ -57,6 +57,10 @@ For support : support@visus.net
 #include <Visus/IdxMultipleAccess.h>
 #include <Visus/IdxDiskAccess.h>
 #include <Visus/IdxFilter.h>
+#include <Visus/Encoder.h>
+#include <Visus/IdxStreamingImporter.h>
+
+#include <fstream>
 
 namespace Visus {
 
@@ -431,7 +435,7 @@ SharedPtr<Access> Dataset::createAccess(StringTree config,bool bForBlockQuery)
     auto ret = std::make_shared<RamAccess>(getDefaultBitsPerBlock());
     ret->can_read = StringUtils::contains(config.readString("chmod", Access::DefaultChMod), "r");
     ret->can_write = StringUtils::contains(config.readString("chmod", Access::DefaultChMod), "w");
-    ret->setAvailableMemory(StringUtils::getByteSizeFromString(config.readString("available", "128mb")));
+    ret->setAvailableMemory(StringUtils::getByteSizeFromString(config.readString("available", "128mb")), cint(config.readString("shards", "16")), config.readString("policy", "lru"));
     return ret;
   }
 
@@ -481,6 +485,67 @@ std::vector<String> Dataset::getAllFilenames()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////
+/* 
+compression with a "dict" option (example "zstd-19-dict") trains one dictionary for each field on a sample of the blocks
+dictionaries are stored alongside the dataset and used by IdxDiskAccess (see getDictionaryFilename)
+*/
+static String GetCompressionDictionarySpecs(std::vector<String> compression)
+{
+  String ret;
+  for (auto it : compression)
+  {
+    auto options = StringUtils::split(it, "-");
+    if (std::find(options.begin(), options.end(), "dict") != options.end())
+      ret = it;
+  }
+  return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+static void TrainCompressionDictionaries(Dataset* db, SharedPtr<Access> access, std::vector<String> compression)
+{
+  String specs = GetCompressionDictionarySpecs(compression);
+  if (specs.empty())
+    return;
+
+  auto encoder = Encoders::getSingleton()->createEncoder(specs);
+  if (!encoder)
+    return;
+
+  const int    max_samples = 1024;
+  const Int64  max_dictionary_size = 112 * 1024;
+
+  String idx_filename = Url(db->getUrl()).getPath();
+  BigInt total_blocks = db->getTotalNumberOfBlocks();
+
+  access->beginRead();
+  for (auto field : db->getFields())
+  {
+    //evenly spaced blocks
+    std::vector< SharedPtr<HeapMemory> > samples;
+    BigInt step = std::max((BigInt)1, total_blocks / max_samples);
+    for (BigInt blockid = 0; blockid < total_blocks && samples.size() < max_samples; blockid += step)
+    {
+      auto query = db->createBlockQuery(blockid, field, db->getTime(), 'r');
+      if (db->executeBlockQueryAndWait(access, query))
+        samples.push_back(query->buffer.heap);
+    }
+
+    auto dictionary = encoder->trainDictionary(field.dtype, samples, max_dictionary_size);
+    if (!dictionary)
+    {
+      PrintWarning("Cannot train compression dictionary", specs, "field", field.name, "nsamples", samples.size());
+      continue;
+    }
+
+    auto filename = IdxDiskAccess::getDictionaryFilename(idx_filename, field);
+    Utils::saveBinaryDocument(filename, dictionary);
+    PrintInfo("Trained compression dictionary", filename, "nsamples", samples.size(), "size", dictionary->c_size());
+  }
+  access->endRead();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 void Dataset::compressDataset(std::vector<String> compression, Array data)
 {
@@ -496,6 +561,9 @@ void Dataset::compressDataset(std::vector<String> compression, Array data)
   int nlevels = getMaxResolution() + 1;
   VisusReleaseAssert(compression.size() <= nlevels);
 
+  //before the expansion (see journal)
+  String compression_specs = StringUtils::join(compression, " ");
+
   // example ["zip","jpeg","jpeg"] means last level "jpeg", last-level-minus-one "jpeg" all others zip
   while (compression.size() < nlevels)
     compression.insert(compression.begin(), compression.front());
@@ -510,9 +578,14 @@ void Dataset::compressDataset(std::vector<String> compression, Array data)
     idxfile.save(filename);
   }
 
-  if (data.valid())
+  //data will replace current data, streamed slab by slab directly into the blocks
+  //(dictionaries need random access to the blocks, in that case the data goes through RAM first)
+  if (data.valid() && GetCompressionDictionarySpecs(compression).empty())
+  {
+    IdxStreamingImporter::importArray(idx, data, compression);
+  }
+  else if (data.valid())
   {
-    //data will replace current data
     //write BoxQuery(==data) to BlockQuery(==RAM)
     auto query = createBoxQuery(getLogicBox(), 'w');
     beginBoxQuery(query);
@@ -520,16 +593,19 @@ void Dataset::compressDataset(std::vector<String> compression, Array data)
     VisusAssert(query->getNumberOfSamples() == data.dims);
     query->buffer = data;
 
-    auto Waccess = std::make_shared<IdxDiskAccess>(idx);
-    Waccess->disableWriteLock();
-    Waccess->disableAsync();
-
     auto Raccess = std::make_shared<RamAccess>(getDefaultBitsPerBlock());
     Raccess->setAvailableMemory(/* no memory limit*/0);
 
     Raccess->disableWriteLock();
     VisusReleaseAssert(executeBoxQuery(Raccess, query));
 
+    //before creating the writer, which loads the dictionaries
+    TrainCompressionDictionaries(this, Raccess, compression);
+
+    auto Waccess = std::make_shared<IdxDiskAccess>(idx);
+    Waccess->disableWriteLock();
+    Waccess->disableAsync();
+
     //read blocks are in RAM assuming there is no file yet stored on disk
     Raccess->beginRead();
     Waccess->beginWrite();
@@ -572,90 +648,250 @@ void Dataset::compressDataset(std::vector<String> compression, Array data)
     compressed_idx_file.filename_template = idxfile.filename_template + suffix;
     compressed_idx_file.save(compressed_idx_filename);
 
-    auto Waccess = std::make_shared<IdxDiskAccess>(idx, compressed_idx_file);
-    auto Raccess = std::make_shared<IdxDiskAccess>(idx, idxfile);
+    //files already compressed by a previous (interrupted) run with the same compression
+    String journal_filename = idx_filename + suffix + ".journal";
+    String journal_header = "compression " + compression_specs;
+    std::set<String> journal;
+    bool bResume = false;
+    if (FileUtils::existsFile(journal_filename))
+    {
+      auto lines = StringUtils::getNonEmptyLines(Utils::loadTextDocument(journal_filename));
+      if (!lines.empty() && StringUtils::trim(lines[0]) == journal_header)
+      {
+        bResume = true;
+        for (int I = 1; I < (int)lines.size(); I++)
+          journal.insert(StringUtils::trim(lines[I]));
+      }
+      else
+      {
+        PrintWarning("Ignoring compression journal", journal_filename, "since compression changed");
+      }
+    }
 
-    Raccess->disableAsync();
-    Raccess->disableWriteLock();
+    StringTree rconfig("access");
+    rconfig.write("disable_async", true);
 
-    Waccess->disableWriteLock();
-    Waccess->disableAsync();
+    //never retrain dictionaries in a resumed run (some files are already compressed with the old ones)
+    if (bResume)
+    {
+      PrintInfo("Resuming compression", journal_filename, "files already compressed", journal.size());
+    }
+    else
+    {
+      //before creating the writers, which load the dictionaries
+      TrainCompressionDictionaries(this, std::make_shared<IdxDiskAccess>(idx, idxfile, rconfig), compression);
+      Utils::saveTextDocument(journal_filename, journal_header + "\n");
+    }
 
-    for (auto time : idxfile.timesteps.asVector())
+    //one job for each file (i.e. the range of blocks stored in it, for all the fields sharing the file)
+    struct Job
     {
-      String prev_filename;
-      auto setFilename = [&](String value)
+      double             time;
+      String             filename;
+      BigInt             from, to;
+      std::vector<Field> fields;
+    };
+
+    std::vector<Job> jobs;
+    {
+      auto naming = std::make_shared<IdxDiskAccess>(idx, idxfile, rconfig);
+      BigInt total_blocks = getTotalNumberOfBlocks();
+      BigInt blocksperfile = std::max((BigInt)1, (BigInt)idxfile.blocksperfile);
+      for (auto time : idxfile.timesteps.asVector())
       {
-        //wait for a filename change
-        if (prev_filename == value)
-          return;
+        for (BigInt from = 0; from < total_blocks; from += blocksperfile)
+        {
+          std::map<String, std::vector<Field> > files;
+          for (auto field : idxfile.fields)
+            files[naming->getFilename(field, time, from)].push_back(field);
 
-        if (!prev_filename.empty())
-          PrintInfo("Compressed file", prev_filename);
+          for (auto it : files)
+          {
+            if (!journal.count(it.first))
+              jobs.push_back(Job{ time, it.first, from, std::min(from + blocksperfile, total_blocks), it.second });
+          }
+        }
+      }
+    }
 
-        // close any read file handle only if it's the last read op
-        if (value.empty())
-          Raccess->endRead();
+    //files are independent, so they are compressed in parallel (the encoding threads are split among the files)
+    int hardware_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    int nworkers = hardware_threads;
+    if (auto env = getenv("VISUS_COMPRESS_NTHREADS"))
+      nworkers = cint(String(env));
+    nworkers = std::max(1, std::min(nworkers, (int)jobs.size()));
+
+    //memory for the uncompressed blocks in flight, split among the workers
+    Int64 max_memory = 1024 * 1024 * 1024;
+    if (auto env = getenv("VISUS_COMPRESS_MAX_MEMORY"))
+      max_memory = StringUtils::getByteSizeFromString(String(env));
+    Int64 worker_memory = max_memory / nworkers;
+
+    StringTree wconfig("access");
+    wconfig.write("disable_async", true);
+    wconfig.write("write_nthreads", std::max(1, hardware_threads / nworkers));
+
+    CriticalSection lock;
+    Int64 ndone = 0, tot_size_before = 0, tot_size_after = 0;
+    std::vector<String> errors;
+    auto t1 = Time::now();
+
+    //appendJournal
+    auto appendJournal = [&](String filename)
+    {
+      ScopedLock lock_journal(lock);
+      std::ofstream out(journal_filename.c_str(), std::ios::app);
+      out << filename << std::endl;
+      ndone++;
+    };
+
+    //compressFile
+    auto compressFile = [&](const Job& job)
+    {
+      auto filename = job.filename;
 
-        //close any write file handle
-        Waccess->endWrite();
+      //interrupted between the remove and the move
+      if (!FileUtils::existsFile(filename) && FileUtils::existsFile(filename + suffix))
+      {
+        VisusReleaseAssert(FileUtils::moveFile(filename + suffix, filename));
+        PrintInfo("Completed interrupted move of compressed file", filename);
+        return appendJournal(filename);
+      }
 
-        //mv filename.~compressed -> filename
-        if (!prev_filename.empty())
-        {
-          VisusReleaseAssert(FileUtils::removeFile(prev_filename));
-          VisusReleaseAssert(FileUtils::moveFile(prev_filename + suffix, prev_filename));
-        }
+      //no blocks at all
+      if (!FileUtils::existsFile(filename))
+        return appendJournal(filename);
 
-        prev_filename = value;
+      //remove any file coming from an old compression process
+      FileUtils::removeFile(filename + suffix);
 
-        if (value.empty())
-        {
-          Raccess->beginRead();
-        }
-        else
-        {
-          //remove any file coming from an old compression process
-          FileUtils::removeFile(value + suffix);
-        }
+      auto t1 = Time::now();
+      auto size_before = FileUtils::getFileSize(filename);
 
-        Waccess->beginWrite();
-      };
+      auto Raccess = std::make_shared<IdxDiskAccess>(idx, idxfile, rconfig);
+      Raccess->disableWriteLock();
 
-      Raccess->beginRead();
-      Waccess->beginWrite();
-      for (BigInt blockid = 0, total_blocks = getTotalNumberOfBlocks(); blockid < total_blocks; blockid++)
+      auto Waccess = std::make_shared<IdxDiskAccess>(idx, compressed_idx_file, wconfig);
+      Waccess->disableWriteLock();
+
+      Int64 nblocks = 0, nbytes = 0;
+      std::vector< SharedPtr<BlockQuery> > read_blocks;
+      Int64 read_bytes = 0;
+
+      auto flush = [&]()
       {
-        for (auto Rfield : idxfile.fields)
-        {
-          auto filename = Raccess->getFilename(Rfield, time, blockid);
-          auto read_block = createBlockQuery(blockid, Rfield, time, 'r');
+        //adjacent reads are coalesced by IdxDiskAccess
+        executeBlockQueries(Raccess, read_blocks);
 
+        std::vector< SharedPtr<BlockQuery> > write_blocks;
+        for (auto read_block : read_blocks)
+        {
           //could fail because block does not exist
-          if (!executeBlockQueryAndWait(Raccess, read_block))
+          read_block->done.get();
+          if (!read_block->ok())
             continue;
 
-          //prepare for writing... 
-          setFilename(filename);
-
           //compression can depend on level
           int H = read_block->H;
           VisusReleaseAssert(H >= 0 && H < compression.size());
 
           //NOTE: the layout will be the same
-
-          auto Wfield = Rfield;
+          auto Wfield = read_block->field;
           Wfield.default_compression = compression[H];
           auto write_block = createBlockQuery(read_block->blockid, Wfield, read_block->time, 'w');
           write_block->buffer = read_block->buffer;
-          VisusReleaseAssert(executeBlockQueryAndWait(Waccess, write_block));
+          write_blocks.push_back(write_block);
+          nbytes += read_block->getByteSize();
+        }
+        read_blocks.clear();
+        read_bytes = 0;
+
+        //encoded in parallel by IdxDiskAccess::writeBlocks
+        executeBlockQueries(Waccess, write_blocks);
+        for (auto write_block : write_blocks)
+        {
+          write_block->done.get();
+          if (write_block->failed())
+            ThrowException("cannot write block", write_block->blockid, "of", filename, write_block->errormsg);
+        }
+        nblocks += (Int64)write_blocks.size();
+      };
+
+      Raccess->beginRead();
+      Waccess->beginWrite();
+      for (BigInt blockid = job.from; blockid < job.to; blockid++)
+      {
+        for (auto field : job.fields)
+        {
+          auto read_block = createBlockQuery(blockid, field, job.time, 'r');
+          read_bytes += read_block->getByteSize();
+          read_blocks.push_back(read_block);
+          if (read_bytes >= worker_memory)
+            flush();
         }
       }
-      setFilename("");
+      flush();
       Raccess->endRead();
       Waccess->endWrite();
+
+      //mv filename.~compressed -> filename
+      if (nblocks)
+      {
+        VisusReleaseAssert(FileUtils::removeFile(filename));
+        VisusReleaseAssert(FileUtils::moveFile(filename + suffix, filename));
+      }
+
+      auto size_after = FileUtils::getFileSize(filename);
+      appendJournal(filename);
+
+      auto sec = std::max(0.001, t1.elapsedSec());
+      ScopedLock lock_stats(lock);
+      tot_size_before += size_before;
+      tot_size_after += size_after;
+      PrintInfo("Compressed file", filename,
+        "blocks", nblocks,
+        "size", StringUtils::getStringFromByteSize(size_before), "->", StringUtils::getStringFromByteSize(size_after),
+        "msec", t1.elapsedMsec(),
+        "MB/sec", (nbytes / (1024.0 * 1024.0)) / sec,
+        "files", ndone, "/", jobs.size());
+    };
+
+    PrintInfo("Compressing", jobs.size(), "files", "nworkers", nworkers, "max-memory", StringUtils::getStringFromByteSize(max_memory));
+
+    auto tpool = nworkers > 1 ? std::make_shared<ThreadPool>("Compress Worker", nworkers) : SharedPtr<ThreadPool>();
+    for (auto& job : jobs)
+    {
+      auto fn = [&, job]() {
+        try
+        {
+          compressFile(job);
+        }
+        catch (std::exception& ex)
+        {
+          ScopedLock lock_errors(lock);
+          errors.push_back(cstring(job.filename, ex.what()));
+        }
+      };
+
+      if (tpool)
+        ThreadPool::push(tpool, fn);
+      else
+        fn();
     }
+    if (tpool)
+      tpool->waitAll();
+    tpool.reset();
 
+    //keep the journal, the next run will resume from here
+    if (!errors.empty())
+      ThrowException("compression failed, run again to resume", StringUtils::join(errors, "\n"));
+
+    PrintInfo("Compression done",
+      "files", jobs.size(),
+      "size", StringUtils::getStringFromByteSize(tot_size_before), "->", StringUtils::getStringFromByteSize(tot_size_after),
+      "msec", t1.elapsedMsec());
+
+    FileUtils::removeFile(journal_filename);
     VisusReleaseAssert(FileUtils::existsFile(compressed_idx_filename));
     FileUtils::removeFile(compressed_idx_filename);
   }
@@ -764,63 +1000,109 @@ SharedPtr<BlockQuery> Dataset::createBlockQuery(BigInt blockid, Field field, dou
 
 ////////////////////////////////////////////////
 void Dataset::executeBlockQuery(SharedPtr<Access> access,SharedPtr<BlockQuery> query)
+{
+  executeBlockQueries(access, { query });
+}
+
+////////////////////////////////////////////////
+void Dataset::executeBlockQueries(SharedPtr<Access> access, std::vector< SharedPtr<BlockQuery> > queries)
 {
   VisusAssert(access->isReading() || access->isWriting());
 
-  int mode = query->mode; 
-  auto failed = [&](String reason) {
+  std::vector< SharedPtr<BlockQuery> > read_queries, write_queries;
 
-    if (!access)
-      query->setFailed(reason);
-    else
-      mode == 'r'? access->readFailed(query, reason) : access->writeFailed(query, reason);
-   
-    if (!reason.empty())
-      PrintInfo("executeBlockQUery failed", reason);
+  for (auto query : queries)
+  {
+    int mode = query->mode;
+    auto failed = [&](String reason) {
 
-    return;
-  };
+      if (!access)
+        query->setFailed(reason);
+      else
+        mode == 'r' ? access->readFailed(query, reason) : access->writeFailed(query, reason);
 
-  if (!access)
-    return failed("no access");
+      if (!reason.empty())
+        PrintInfo("executeBlockQUery failed", reason);
 
-  if (!query->field.valid())
-    return failed("field not valid");
+      return;
+    };
+
+    if (!access)
+    {
+      failed("no access");
+      continue;
+    }
 
-  if (query->blockid < 0)
-    return failed("address range not valid");
+    if (!query->field.valid())
+    {
+      failed("field not valid");
+      continue;
+    }
 
-  if ((mode == 'r' && !access->can_read) || (mode == 'w' && !access->can_write))
-    return failed("rw not enabled");
+    if (query->blockid < 0)
+    {
+      failed("address range not valid");
+      continue;
+    }
 
-  if (!query->logic_samples.valid())
-    return failed("logic_samples not valid");
+    if ((mode == 'r' && !access->can_read) || (mode == 'w' && !access->can_write))
+    {
+      failed("rw not enabled");
+      continue;
+    }
 
-  //scrgiorgio: add this optimization to avoid empty blocks
-  if (!query->logic_samples.logic_box.intersect(this->getLogicBox()))
-    return failed("");//"no intersection with logic box" (TOO many messages with )
+    if (!query->logic_samples.valid())
+    {
+      failed("logic_samples not valid");
+      continue;
+    }
 
-  if (mode == 'w' && !query->buffer.valid())
-    return failed("no buffer to write");
+    //scrgiorgio: add this optimization to avoid empty blocks
+    if (!query->logic_samples.logic_box.intersect(this->getLogicBox()))
+    {
+      failed("");//"no intersection with logic box" (TOO many messages with )
+      continue;
+    }
 
-  // override time  from from field
-  if (query->field.hasParam("time"))
-    query->time = cdouble(query->field.getParam("time"));
+    if (mode == 'w' && !query->buffer.valid())
+    {
+      failed("no buffer to write");
+      continue;
+    }
 
-  query->setRunning();
+    // override time  from from field
+    if (query->field.hasParam("time"))
+      query->time = cdouble(query->field.getParam("time"));
 
-  if (mode == 'r')
-  {
-    access->readBlock(query);
-    BlockQuery::readBlockEvent();
+    query->setRunning();
+
+    if (mode == 'r')
+      read_queries.push_back(query);
+    else
+      write_queries.push_back(query);
   }
-  else
+
+  if (!write_queries.empty())
   {
-    access->writeBlock(query);
-    BlockQuery::writeBlockEvent();
+    if (write_queries.size() == 1)
+      access->writeBlock(write_queries[0]);
+    else
+      access->writeBlocks(write_queries);
+
+    for (int I = 0; I < (int)write_queries.size(); I++)
+      BlockQuery::writeBlockEvent();
   }
 
-  return;
+  if (!read_queries.empty())
+  {
+    if (read_queries.size() == 1)
+      access->readBlock(read_queries[0]);
+    else
+      access->readBlocks(read_queries);
+
+    for (int I = 0; I < (int)read_queries.size(); I++)
+      BlockQuery::readBlockEvent();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -943,13 +1225,89 @@ void Dataset::beginBoxQuery(SharedPtr<BoxQuery> query)
 
   for (auto it : query->end_resolutions)
   {
-    if (setBoxQueryEndResolution(query, it))
-      return query->setRunning();
+    if (!setBoxQueryEndResolution(query, it))
+      continue;
+
+    //progressive refinement in place, I need the logic samples of the final resolution
+    if (query->inplace.enabled)
+    {
+      query->inplace.enabled = query->mode == 'r' && query->start_resolution == 0 && !query->filter.dataset_filter 
+        && !blocksFullRes() && !this->missing_blocks && it < query->end_resolutions.back();
+
+      if (query->inplace.enabled)
+      {
+        auto logic_samples = query->logic_samples;
+        query->inplace.enabled = setBoxQueryEndResolution(query, query->end_resolutions.back());
+        query->inplace.logic_samples = query->logic_samples;
+        query->end_resolution = it;
+        query->logic_samples = logic_samples;
+      }
+    }
+
+    return query->setRunning();
   }
 
   query->setFailed("cannot find a good end_resolution to start with");
 }
 
+//////////////////////////////////////////////////////////////
+//process-wide pools merging blocks into box queries, shared by all the queries (NOTE: never destroyed, idle workers are just waiting for jobs)
+//the number of workers is read once, when the pool is created (default hardware_concurrency, <=1 means merging in the calling thread)
+class BoxQueryMergeWorkers
+{
+public:
+
+  int                   nthreads = 1;
+  SharedPtr<ThreadPool> tpool;
+
+  //constructor
+  BoxQueryMergeWorkers(String basename, const char* env_name)
+  {
+    nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+    if (auto env = getenv(env_name))
+      nthreads = cint(String(env));
+
+    if (nthreads > 1)
+      tpool = std::make_shared<ThreadPool>(basename, nthreads);
+  }
+
+  //getReadWorkers
+  static BoxQueryMergeWorkers& getReadWorkers() {
+    static auto ret = new BoxQueryMergeWorkers("Dataset Read Worker", "VISUS_READ_NTHREADS");
+    return *ret;
+  }
+
+  //getWriteWorkers
+  static BoxQueryMergeWorkers& getWriteWorkers() {
+    static auto ret = new BoxQueryMergeWorkers("Dataset Write Worker", "VISUS_WRITE_NTHREADS");
+    return *ret;
+  }
+
+  //isEnabled (a worker must not wait for other workers, nested queries merge in the calling thread)
+  bool isEnabled() const {
+    return tpool && !bInsideWorker();
+  }
+
+  //push
+  void push(std::function<void()> fn)
+  {
+    ThreadPool::push(tpool, [fn]() {
+      bInsideWorker() = true;
+      fn();
+      bInsideWorker() = false;
+    });
+  }
+
+private:
+
+  //bInsideWorker
+  static bool& bInsideWorker() {
+    static thread_local bool ret = false;
+    return ret;
+  }
+
+};
+
 //////////////////////////////////////////////////////////////
 bool Dataset::executeBoxQuery(SharedPtr<Access> access, SharedPtr<BoxQuery> query)
 {
@@ -972,6 +1330,10 @@ bool Dataset::executeBoxQuery(SharedPtr<Access> access, SharedPtr<BoxQuery> quer
     return false;
   }
 
+  //merge the new levels directly in the final resolution buffer (pure remote queries restart from scratch anyway)
+  if (query->inplace.enabled && access)
+    return executeBoxQueryInPlace(access, query);
+
   if (!query->allocateBufferIfNeeded())
   {
     query->setFailed("cannot allocate buffer");
@@ -1019,32 +1381,84 @@ bool Dataset::executeBoxQuery(SharedPtr<Access> access, SharedPtr<BoxQuery> quer
     }
 	}
 
-  for (auto blockid : blocks)
+  //reading: the merge (i.e. decoding/hzorder scatter) runs on the read workers instead of the thread completing the read
+  //(blocks write disjoint samples of the query buffer, so they can be merged concurrently without locks)
+  //the buffer must exist before merging concurrently
+  bool bParallelRead = query->mode == 'r' && blocks.size() >= 16 && BoxQueryMergeWorkers::getReadWorkers().isEnabled() && query->allocateBufferIfNeeded();
+
+  //reading: blocks are passed to the access in batches, so that reads of adjacent blocks can be coalesced
+  const int read_batch_size = 256;
+  for (int I = 0; query->mode == 'r' && I < (int)blocks.size(); I += read_batch_size)
   {
     if (query->aborted())
       break;
 
-    nread++;
+    std::vector< SharedPtr<BlockQuery> > read_blocks;
+    for (int J = I; J < std::min((int)blocks.size(), I + read_batch_size); J++)
+      read_blocks.push_back(createBlockQuery(blocks[J], query->field, query->time, 'r', query->aborted));
 
-    auto read_block = createBlockQuery(blockid, query->field, query->time, 'r', query->aborted);
+    nread += (int)read_blocks.size();
+    executeBlockQueries(access, read_blocks);
 
-		if (query->mode == 'r')
+    for (auto read_block : read_blocks)
     {
-      executeBlockQuery(access, read_block);
-      wait_async.pushRunning(read_block->done, [this, query, read_block](Void) {
-        //I don't care if the read fails...
-        if (!query->aborted() && read_block->ok())
-          mergeBoxQueryWithBlockQuery(query, read_block);
+      if (!bParallelRead)
+      {
+        wait_async.pushRunning(read_block->done, [this, query, read_block](Void) {
+          //I don't care if the read fails...
+          if (!query->aborted() && read_block->ok())
+            mergeBoxQueryWithBlockQuery(query, read_block);
+          });
+        continue;
+      }
+
+      //a block is running until merged (so that max_running also limits the blocks waiting for the merge)
+      Promise<Void> merged;
+      read_block->done.when_ready([this, query, read_block, merged](Void) {
+        BoxQueryMergeWorkers::getReadWorkers().push([this, query, read_block, merged]() mutable {
+          //I don't care if the read fails...
+          if (!query->aborted() && read_block->ok())
+            mergeBoxQueryWithBlockQuery(query, read_block);
+          merged.set_value(Void());
+          });
         });
+      wait_async.pushRunning(merged.get_future(), [](Void) {});
     }
-    else
-    {
-      //need a lease... so that I can read/merge/write like in a transaction mode
+  }
+
+  //writing: each batch of blocks is read ahead (coalesced), merged in parallel, and handed to the access all together
+  //(so that it can encode in parallel and serialize only the final file writes)
+  const int write_batch_size = 256;
+  bool bParallelWrite = query->mode == 'w' && blocks.size() > 1 && BoxQueryMergeWorkers::getWriteWorkers().isEnabled();
+
+  for (int I = 0; query->mode == 'w' && I < (int)blocks.size(); I += write_batch_size)
+  {
+    if (query->aborted())
+      break;
+
+    std::vector< SharedPtr<BlockQuery> > read_blocks;
+    for (int J = I; J < std::min((int)blocks.size(), I + write_batch_size); J++)
+      read_blocks.push_back(createBlockQuery(blocks[J], query->field, query->time, 'r', query->aborted));
+
+    //need a lease... so that I can read/merge/write like in a transaction mode
+    //(always locking in the same order, so that two writers cannot deadlock)
+    auto locks = read_blocks;
+    std::stable_sort(locks.begin(), locks.end(), [&access](const SharedPtr<BlockQuery>& a, const SharedPtr<BlockQuery>& b) {
+      return access->getFilename(a) < access->getFilename(b);
+    });
+
+    for (auto read_block : locks)
       access->acquireWriteLock(read_block);
 
-      //need to read and wait the block
-      executeBlockQueryAndWait(access, read_block);
+    //need to read and wait the blocks
+    nread += (int)read_blocks.size();
+    executeBlockQueries(access, read_blocks);
+    for (auto read_block : read_blocks)
+      read_block->done.get();
 
+    std::vector< SharedPtr<BlockQuery> > write_blocks;
+    for (auto read_block : read_blocks)
+    {
       auto write_block = createBlockQuery(read_block->blockid, query->field, query->time, 'w', query->aborted);
 
       //read ok
@@ -1054,21 +1468,46 @@ bool Dataset::executeBoxQuery(SharedPtr<Access> access, SharedPtr<BoxQuery> quer
       else
         write_block->allocateBufferIfNeeded();
 
-      //here a change in the layout (hzorder) can happen
-      mergeBoxQueryWithBlockQuery(query, write_block);
+      write_blocks.push_back(write_block);
+    }
+
+    //here a change in the layout (hzorder) can happen
+    if (bParallelWrite && write_blocks.size() > 1)
+    {
+      //the pool is shared with other queries, wait only for my own blocks
+      Semaphore merged;
+      for (auto write_block : write_blocks)
+        BoxQueryMergeWorkers::getWriteWorkers().push([this, query, write_block, &merged]() {
+          mergeBoxQueryWithBlockQuery(query, write_block);
+          merged.up();
+        });
+      for (int K = 0; K < (int)write_blocks.size(); K++)
+        merged.down();
+    }
+    else
+    {
+      for (auto write_block : write_blocks)
+        mergeBoxQueryWithBlockQuery(query, write_block);
+    }
 
-      //need to write and wait for the block
-      executeBlockQueryAndWait(access, write_block);
-      nwrite++;
+    //need to write and wait for the blocks
+    executeBlockQueries(access, write_blocks);
+    bool bFailed = false;
+    for (auto write_block : write_blocks)
+    {
+      write_block->done.get();
+      bFailed = bFailed || write_block->failed();
+    }
+    nwrite += (int)write_blocks.size();
 
-      //important! all writings are with a lease!
+    //important! all writings are with a lease!
+    for (auto read_block : locks)
       access->releaseWriteLock(read_block);
 
-      if (query->aborted() || write_block->failed()) {
-        if (bEndIO) 
-          access->endIO();
-        return false;
-      }
+    if (query->aborted() || bFailed) {
+      if (bEndIO) 
+        access->endIO();
+      return false;
     }
   }
 
@@ -1119,7 +1558,11 @@ void Dataset::nextBoxQuery(SharedPtr<BoxQuery> query)
   query->buffer = Array();
 
   //merge with previous results
-  if (this->missing_blocks)
+  if (query->inplace.enabled)
+  {
+    //the samples of the previous levels are already in query->inplace.buffer
+  }
+  else if (this->missing_blocks)
   {
     if (!query->allocateBufferIfNeeded())
       return failed("out of memory");
@@ -1163,6 +1606,67 @@ void Dataset::nextBoxQuery(SharedPtr<BoxQuery> query)
   query->setCurrentResolution(Rcurrent_resolution);
 }
 
+//////////////////////////////////////////////////////////////
+bool Dataset::executeBoxQueryInPlace(SharedPtr<Access> access, SharedPtr<BoxQuery> query)
+{
+  auto& inplace = query->inplace;
+
+  //allocate the final resolution buffer only once
+  if (!inplace.buffer.valid())
+  {
+    if (!inplace.buffer.resize(inplace.logic_samples.nsamples, query->field.dtype, __FILE__, __LINE__))
+    {
+      query->setFailed("cannot allocate buffer");
+      return false;
+    }
+
+    inplace.buffer.fillWithValue(query->field.default_value);
+    inplace.buffer.layout = query->field.default_layout;
+  }
+
+  //blocks will write their samples to their final position, skipping the levels already merged
+  auto Lsamples = query->logic_samples;
+  query->logic_samples = inplace.logic_samples;
+  query->buffer = inplace.buffer;
+
+  inplace.enabled = false;
+  bool bOk = executeBoxQuery(access, query);
+  inplace.enabled = true;
+
+  query->logic_samples = Lsamples;
+  query->buffer = Array();
+
+  if (!bOk)
+    return false;
+
+  //final resolution, no copy needed
+  if (Lsamples.logic_box == inplace.logic_samples.logic_box && Lsamples.delta == inplace.logic_samples.delta)
+  {
+    query->buffer = inplace.buffer;
+    return true;
+  }
+
+  //copy the samples of the current level (usually much smaller than the final buffer)
+  Array buffer;
+  if (!buffer.resize(Lsamples.nsamples, query->field.dtype, __FILE__, __LINE__))
+  {
+    query->setFailed("cannot allocate buffer");
+    return false;
+  }
+
+  buffer.fillWithValue(query->field.default_value);
+  buffer.layout = query->field.default_layout;
+
+  if (!insertSamples(Lsamples, buffer, inplace.logic_samples, inplace.buffer, query->aborted))
+  {
+    query->setFailed(query->aborted() ? "query aborted" : "insert samples failed");
+    return false;
+  }
+
+  query->buffer = buffer;
+  return true;
+}
+
 ////////////////////////////////////////////////
 int Dataset::guessBoxQueryEndResolution(Frustum logic_to_screen, Position logic_position)
 {
@@ -2104,6 +2608,229 @@ bool Dataset::computeFilter(SharedPtr<IdxFilter> filter, double time, Field fiel
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+bool Dataset::computeFilterPyramid(SharedPtr<IdxFilter> filter, double time, Field field, Int64 max_tile_samples, bool bVerbose)
+{
+  VisusAssert(!blocksFullRes());
+
+  //this works only for filter_size==2 (see computeFilter)
+  VisusAssert(filter->size == 2);
+
+  DatasetBitmask bitmask = this->idxfile.bitmask;
+  BoxNi          logic_box = this->getLogicBox();
+  BoxNi          pow2_box = bitmask.getPow2Box();
+  int            pdim = bitmask.getPointDim();
+  int            maxh = this->getMaxResolution();
+  int            bitsperblock = this->getDefaultBitsPerBlock();
+
+  /* A tile is made of all the samples sharing the first M bits of the bitmask. 
+  The filter step at resolution H never exceeds the tile size for H>M, so levels (M,Hc] can be computed with only 
+  one read and one write of the tile. Blocks of resolution >M+bitsperblock are entirely inside one tile, 
+  the coarser ones are shared (i.e. read-merge-write by one tile at a time).
+  The coarse levels [0,M] are done by a next pass on the (much smaller) grid of resolution M */
+  max_tile_samples = std::max(max_tile_samples, ((Int64)1) << (bitsperblock + 1));
+
+  int nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+  if (auto env = getenv("VISUS_FILTER_NTHREADS"))
+    nthreads = std::max(1, cint(String(env)));
+
+  //one writer for all tiles (the access encodes blocks in parallel)
+  auto waccess = createAccess();
+  waccess->disableWriteLock();
+  waccess->beginWrite();
+  CriticalSection wlock;
+
+  //readers are reused by tiles
+  std::vector< SharedPtr<Access> > raccesses;
+  CriticalSection rlock;
+
+  Aborted aborted;
+  String errormsg;
+  auto t1 = Time::now();
+
+  for (int Hc = maxh; Hc >= 1 && !aborted(); )
+  {
+    int M = 0;
+    while (M < Hc && (((Int64)1) << (Hc - M)) > max_tile_samples)
+      M++;
+
+    int Hs = std::min(M + bitsperblock, Hc);
+
+    PointNi tile_size = PointNi::one(pdim);
+    for (int K = M + 1; K <= maxh; K++)
+      tile_size[bitmask[K]] <<= 1;
+
+    std::vector<BoxNi> tiles;
+    for (auto P = ForEachPoint(pow2_box.p1, pow2_box.p2, tile_size); !P.end(); P.next())
+    {
+      auto tile = BoxNi(P.pos, P.pos + tile_size).getIntersection(logic_box);
+      if (tile.isFullDim())
+        tiles.push_back(tile);
+    }
+
+    if (bVerbose)
+      PrintInfo("Applying filter to dataset resolutions", Hc, "...", M + 1, "tile_size", tile_size, "ntiles", tiles.size());
+
+    auto computeTile = [&](BoxNi tile)
+    {
+      auto query = createBoxQuery(tile, field, time, 'r', aborted);
+      query->setResolutionRange(0, Hc);
+      beginBoxQuery(query);
+      if (!query->isRunning() || !query->allocateBufferIfNeeded())
+        ThrowException("cannot create tile query", tile.toString());
+
+      std::vector< SharedPtr<BlockQuery> > owned, shared;
+      for (auto blockid : createBlockQueriesForBoxQuery(query))
+      {
+        auto block = createBlockQuery(blockid, field, time, 'r', aborted);
+        (block->H > Hs ? owned : shared).push_back(block);
+      }
+
+      auto readBlocks = [&](SharedPtr<Access> access, std::vector< SharedPtr<BlockQuery> > blocks) {
+        executeBlockQueries(access, blocks);
+        for (auto block : blocks)
+        {
+          block->done.get();
+          //I don't care if the read fails... maybe does not exist
+          if (block->ok())
+            mergeBoxQueryWithBlockQuery(query, block);
+        }
+      };
+
+      //owned blocks are written only by this tile, no need to lock
+      SharedPtr<Access> raccess;
+      {
+        ScopedLock lock(rlock);
+        if (!raccesses.empty())
+        {
+          raccess = raccesses.back();
+          raccesses.pop_back();
+        }
+        else
+        {
+          raccess = createAccess();
+        }
+      }
+
+      raccess->beginRead();
+      readBlocks(raccess, owned);
+      raccess->endRead();
+
+      {
+        ScopedLock lock(rlock);
+        raccesses.push_back(raccess);
+      }
+
+      //shared blocks can be rewritten by other tiles
+      {
+        ScopedLock lock(wlock);
+        readBlocks(waccess, shared);
+      }
+
+      //FINE TO COARSE, all in memory
+      for (int H = Hc; H > M && !aborted(); H--)
+      {
+        query->setCurrentResolution(H);
+        filter->internalComputeFilter(query.get(), /*bInverse*/false);
+      }
+
+      if (aborted())
+        return;
+
+      auto write = createBoxQuery(tile, field, time, 'w', aborted);
+      write->setResolutionRange(0, Hc);
+      beginBoxQuery(write);
+      if (!write->isRunning())
+        ThrowException("cannot create tile query", tile.toString());
+      write->buffer = query->buffer;
+
+      std::vector< SharedPtr<BlockQuery> > write_blocks;
+      for (auto read_block : owned)
+      {
+        auto write_block = createBlockQuery(read_block->blockid, field, time, 'w', aborted);
+        if (read_block->ok())
+          write_block->buffer = read_block->buffer;
+        else
+          write_block->allocateBufferIfNeeded();
+        mergeBoxQueryWithBlockQuery(write, write_block);
+        write_blocks.push_back(write_block);
+      }
+
+      //coarse samples (only final for (M,Hs]) go to the shared blocks
+      auto coarse = write;
+      if (Hs < Hc)
+      {
+        coarse = createBoxQuery(tile, field, time, 'w', aborted);
+        coarse->setResolutionRange(0, Hs);
+        beginBoxQuery(coarse);
+        if (!coarse->isRunning())
+          ThrowException("cannot create tile query", tile.toString());
+        coarse->buffer = Array(coarse->getNumberOfSamples(), field.dtype);
+        insertSamples(coarse->logic_samples, coarse->buffer, query->logic_samples, query->buffer, aborted);
+      }
+
+      ScopedLock lock(wlock);
+
+      executeBlockQueries(waccess, write_blocks);
+      for (auto write_block : write_blocks)
+      {
+        write_block->done.get();
+        if (write_block->failed())
+          ThrowException("cannot write block", write_block->blockid, write_block->errormsg);
+      }
+
+      if (!executeBoxQuery(waccess, coarse))
+        ThrowException("cannot write tile", tile.toString());
+    };
+
+    SharedPtr<ThreadPool> tpool;
+    if (nthreads > 1 && tiles.size() > 1)
+      tpool = std::make_shared<ThreadPool>("Dataset Filter Worker", std::min(nthreads, (int)tiles.size()));
+
+    for (auto tile : tiles)
+    {
+      auto fn = [&, tile]() {
+        if (aborted())
+          return;
+        try
+        {
+          computeTile(tile);
+        }
+        catch (std::exception& ex)
+        {
+          ScopedLock lock(rlock);
+          if (errormsg.empty())
+            errormsg = ex.what();
+          aborted.setTrue();
+        }
+      };
+
+      if (tpool)
+        ThreadPool::push(tpool, fn);
+      else
+        fn();
+    }
+
+    if (tpool)
+      tpool->waitAll();
+
+    Hc = M;
+  }
+
+  waccess->endWrite();
+
+  if (aborted())
+  {
+    PrintWarning("computeFilterPyramid failed", errormsg);
+    return false;
+  }
+
+  if (bVerbose)
+    PrintInfo("Filter computed in", t1.elapsedMsec(), "msec", "nthreads", nthreads);
+
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Dataset::computeFilter(const Field& field, int window_size, bool bVerbose)
 {
@@ -2114,14 +2841,13 @@ void Dataset::computeFilter(const Field& field, int window_size, bool bVerbose)
 
   auto filter = createFilter(field);
 
-  //the filter will be applied using this sliding window
-  PointNi sliding_box = PointNi::one(getPointDim());
+  //each tile has (at most) the samples of the window
+  Int64 max_tile_samples = 1;
   for (int D = 0; D < getPointDim(); D++)
-    sliding_box[D] = window_size;
+    max_tile_samples = std::min(max_tile_samples * window_size, ((Int64)1) << 30);
 
-  auto acess = createAccess();
   for (auto time : getTimesteps().asVector())
-    computeFilter(filter, time, field, acess, sliding_box, bVerbose);
+    computeFilterPyramid(filter, time, field, max_tile_samples, bVerbose);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
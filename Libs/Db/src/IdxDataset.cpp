@@ -49,6 +49,169 @@ public:
   //execute
   template <class Sample>
   bool execute(IdxDataset* vf, BoxQuery* query, BlockQuery* block_query)
+  {
+    //bit aligned samples cannot be addressed with a pointer
+    if (std::is_same<Sample, BitAlignedSample>::value)
+      return executeWithKdTraversal<Sample>(vf, query, block_query);
+
+    return query->mode == 'w' ?
+      executeWithTables<Sample, true >(vf, query, block_query) :
+      executeWithTables<Sample, false>(vf, query, block_query);
+  }
+
+private:
+
+  /*
+  the samples of level H inside a block are 2^nbits, and each bit of the (local) hz address is a split of the kd-tree
+  (from the most significant: split along bitmask[Hroot], then bitmask[Hroot+1], ...). So the position of the sample is:
+
+      P = zbox.p1 + sum of the deltas of the bits set
+
+  and the offset in the row major query buffer is separable too. I split the hz bits in two halves (hi and lo) and
+  precompute two tiny tables, so the inner loop is just a gather/scatter with a lookup
+  */
+  template <class Sample, bool bInvertOrder>
+  bool executeWithTables(IdxDataset* vf, BoxQuery* query, BlockQuery* block_query)
+  {
+    VisusAssert(query->field.dtype == block_query->buffer.dtype);
+    VisusAssert(block_query->buffer.layout == "hzorder");
+
+    auto bitsperblock = vf->getDefaultBitsPerBlock();
+    int  samplesperblock = 1 << bitsperblock;
+
+    DatasetBitmask bitmask = vf->idxfile.bitmask;
+    int            pdim = bitmask.getPointDim();
+    int            max_resolution = vf->getMaxResolution();
+    BigInt         HzFrom = block_query->blockid * samplesperblock;
+    HzOrder        hzorder(bitmask);
+    int            hstart = std::max(query->getCurrentResolution() + 1, block_query->blockid == 0 ? 0 : block_query->H);
+    int            hend = std::min(query->getEndResolution(), block_query->H);
+
+    VisusAssert(HzFrom == 0 || hstart == hend);
+
+    auto QUERY = (Sample*)query->buffer.c_ptr();
+    auto BLOCK = (Sample*)block_query->buffer.c_ptr();
+
+    BoxNi            logic_box = query->logic_samples.logic_box;
+    PointNi          stride = query->getNumberOfSamples().stride();
+    PointNi          qshift = query->logic_samples.shift;
+    Aborted          aborted = query->aborted;
+
+    //layout of the block
+    auto block_logic_box = block_query->getLogicBox();
+    if (!block_logic_box.valid())
+      return false;
+
+    //deltas
+    std::vector<Int64> deltas(max_resolution + 1);
+    for (int H = 0; H <= max_resolution; H++)
+      deltas[H] = H ? (vf->level_samples[H].delta[bitmask[H]] >> 1) : 0;
+
+    for (int H = hstart; H <= hend; H++)
+    {
+      if (aborted())
+        return false;
+
+      LogicSamples Lsamples = vf->level_samples[H];
+
+      BoxNi   zbox = (HzFrom != 0) ? block_logic_box : Lsamples.logic_box;
+      Int64   hzfrom = cint64(hzorder.getAddress(zbox.p1) - HzFrom);
+
+      BoxNi user_box = logic_box.getIntersection(zbox);
+      BoxNi box = Lsamples.alignBox(user_box);
+      if (!box.isFullDim())
+        continue;
+
+      int Hroot = H ? std::max(1, H - bitsperblock) : 0;
+      int nbits = H - Hroot;
+      int nlo = nbits / 2, nhi = nbits - nlo;
+
+      //per-dimension offset of each half (note: delta is a multiple of the query step, so the shift is exact)
+      std::vector<Int64> lo_offset(pdim << nlo, 0), hi_offset(pdim << nhi, 0);
+      std::vector<Int64> lo_index(1 << nlo, 0), hi_index(1 << nhi, 0);
+      PointNi lo_max(pdim), hi_max(pdim);
+      for (int B = 0; B < nbits; B++)
+      {
+        int   level = Hroot + (nbits - 1 - B);
+        int   bit   = bitmask[level];
+        Int64 delta = deltas[level];
+        Int64 index = stride[bit] * (delta >> qshift[bit]);
+        bool  is_lo = B < nlo;
+        int   N     = is_lo ? B : B - nlo;
+        auto& offset = is_lo ? lo_offset : hi_offset;
+        auto& table  = is_lo ? lo_index  : hi_index;
+        (is_lo ? lo_max : hi_max)[bit] += delta;
+        for (int J = 0, Tot = (int)table.size(); J < Tot; J++)
+        {
+          if (J & (1 << N))
+          {
+            offset[J * pdim + bit] += delta;
+            table[J] += index;
+          }
+        }
+      }
+
+      Int64 base = stride.dotProduct((zbox.p1 - logic_box.p1).rightShift(qshift));
+
+      //all samples inside the query box (the common case for big queries)
+      bool bInside = true;
+      for (int D = 0; D < pdim; D++)
+        bInside = bInside && zbox.p1[D] >= box.p1[D] && zbox.p1[D] + lo_max[D] + hi_max[D] < box.p2[D];
+
+      const auto LO = &lo_index[0];
+      const int  nlo_samples = 1 << nlo;
+
+      for (int Hi = 0, Tot = (int)hi_index.size(); Hi < Tot; Hi++)
+      {
+        auto block_row = BLOCK + hzfrom + ((Int64)Hi << nlo);
+        Int64 query_row = base + hi_index[Hi]; //an offset, rows outside the box would form an out-of-range pointer
+
+        if (bInside)
+        {
+          for (int Lo = 0; Lo < nlo_samples; Lo++)
+          {
+            if (bInvertOrder)
+              block_row[Lo] = QUERY[query_row + LO[Lo]];
+            else
+              QUERY[query_row + LO[Lo]] = block_row[Lo];
+          }
+          continue;
+        }
+
+        //skip the row if it cannot intersect the box
+        PointNi P = zbox.p1;
+        bool bSkip = false;
+        for (int D = 0; D < pdim; D++)
+        {
+          P[D] += hi_offset[Hi * pdim + D];
+          bSkip = bSkip || P[D] + lo_max[D] < box.p1[D] || P[D] >= box.p2[D];
+        }
+        if (bSkip)
+          continue;
+
+        for (int Lo = 0; Lo < nlo_samples; Lo++)
+        {
+          auto offset = &lo_offset[Lo * pdim];
+          bool bValid = true;
+          for (int D = 0; bValid && D < pdim; D++)
+            bValid = P[D] + offset[D] >= box.p1[D] && P[D] + offset[D] < box.p2[D];
+          if (!bValid)
+            continue;
+
+          if (bInvertOrder)
+            block_row[Lo] = QUERY[query_row + LO[Lo]];
+          else
+            QUERY[query_row + LO[Lo]] = block_row[Lo];
+        }
+      }
+    }
+
+    return true;
+  }
+
+  //executeWithKdTraversal (generic version, one sample at a time)
+  template <class Sample>
+  bool executeWithKdTraversal(IdxDataset* vf, BoxQuery* query, BlockQuery* block_query)
   {
     VisusAssert(query->field.dtype == block_query->buffer.dtype);
 
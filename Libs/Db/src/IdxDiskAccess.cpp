@@ -46,6 +46,9 @@ For support : support@visus.net
 #include <Visus/IdxHzOrder.h>
 #include <Visus/StringTree.h>
 #include <Visus/ByteOrder.h>
+#include <Visus/Time.h>
+
+#include <list>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -184,6 +187,126 @@ static String GetFilenameV56(const IdxFile& idxfile, String TimeTemplate, String
 
 
 
+
+//////////////////////////////////////////////////////////////////////////////////
+/* 
+Process-wide cache of decoded (i.e. host byte order) header tables, shared by all IdxDiskAccess instances.
+Entries are validated against last modification time and file size, so that files changed by another process are read again.
+Files written by this process are explicitely invalidated.
+*/
+class IdxHeaderCache
+{
+public:
+
+  VISUS_NON_COPYABLE_CLASS(IdxHeaderCache)
+
+  //constructor
+  IdxHeaderCache() 
+  {
+    this->max_bytes = 64 * 1024 * 1024;
+    if (auto env = getenv("VISUS_IDX_HEADER_CACHE_SIZE"))
+      this->max_bytes = StringUtils::getByteSizeFromString(env);
+  }
+
+  //getSingleton
+  static IdxHeaderCache* getSingleton() {
+    static IdxHeaderCache ret;
+    return &ret;
+  }
+
+  //get
+  bool get(String filename, Int64 mtime, Int64 filesize, HeapMemory& dst)
+  {
+    ScopedLock lock(this->lock);
+
+    auto it = entries.find(filename);
+    if (it == entries.end())
+      return false;
+
+    auto& entry = it->second;
+    if (entry.mtime != mtime || entry.filesize != filesize || entry.headers->c_size() != dst.c_size())
+    {
+      remove(it);
+      return false;
+    }
+
+    memcpy(dst.c_ptr(), entry.headers->c_ptr(), (size_t)dst.c_size());
+    lru.splice(lru.begin(), lru, entry.lru);
+    return true;
+  }
+
+  //put
+  void put(String filename, Int64 mtime, Int64 filesize, const HeapMemory& src)
+  {
+    //the file could be still being written in the same second
+    if (mtime <= 0 || (Time::now().getUTCMilliseconds() / 1000 - mtime) < 2)
+      return;
+
+    if (max_bytes <= 0 || src.c_size() > max_bytes)
+      return;
+
+    ScopedLock lock(this->lock);
+
+    auto it = entries.find(filename);
+    if (it != entries.end())
+      remove(it);
+
+    while (!lru.empty() && (used + src.c_size()) > max_bytes)
+      remove(entries.find(lru.back()));
+
+    auto headers = std::make_shared<HeapMemory>();
+    if (!headers->resize(src.c_size(), __FILE__, __LINE__))
+      return;
+    memcpy(headers->c_ptr(), src.c_ptr(), (size_t)src.c_size());
+
+    lru.push_front(filename);
+
+    Entry entry;
+    entry.mtime = mtime;
+    entry.filesize = filesize;
+    entry.headers = headers;
+    entry.lru = lru.begin();
+    entries[filename] = entry;
+    used += headers->c_size();
+  }
+
+  //invalidate
+  void invalidate(String filename)
+  {
+    ScopedLock lock(this->lock);
+    auto it = entries.find(filename);
+    if (it != entries.end())
+      remove(it);
+  }
+
+private:
+
+  //_____________________________________________
+  class Entry
+  {
+  public:
+    Int64                       mtime = 0;
+    Int64                       filesize = 0;
+    SharedPtr<HeapMemory>       headers;
+    std::list<String>::iterator lru;
+  };
+
+  CriticalSection               lock;
+  Int64                         max_bytes = 0;
+  Int64                         used = 0;
+  std::map<String, Entry>       entries;
+  std::list<String>             lru;
+
+  //remove
+  void remove(std::map<String, Entry>::iterator it)
+  {
+    used -= it->second.headers->c_size();
+    lru.erase(it->second.lru);
+    entries.erase(it);
+  }
+
+};
+
 //////////////////////////////////////////////////////////////////////////////////
 class IdxDiskAccessV5 : public Access
 {
@@ -364,6 +487,12 @@ private:
       return false;
     }
 
+    //already decoded by some other access
+    Int64 mtime = FileUtils::getTimeLastModified(filename);
+    Int64 filesize = this->file.size();
+    if (IdxHeaderCache::getSingleton()->get(filename, mtime, filesize, this->headers))
+      return true;
+
     //read the headers
     if (!this->file.read(0, this->headers.c_size(), this->headers.c_ptr()))
     {
@@ -378,6 +507,7 @@ private:
         ptr[I] = ByteOrder::swapByteOrder(ptr[I]);
     }
 
+    IdxHeaderCache::getSingleton()->put(filename, mtime, filesize, this->headers);
     return true;
   }
 
@@ -484,38 +614,138 @@ public:
     if (!file->read(block_offset, encoded->c_size(), encoded->c_ptr()))
       return failed("cannot read encoded buffer");
 
-    if (bVerbose)
-      PrintInfo("Decoding buffer");
+    decodeBlock(query, block_header, encoded);
+  }
 
-    if (aborted())
-      return failed("aborted");
+  //readBlocks
+  virtual void readBlocks(std::vector< SharedPtr<BlockQuery> > queries) override
+  {
+    if (queries.size() <= 1)
+    {
+      for (auto query : queries)
+        readBlock(query);
+      return;
+    }
 
-#if 1
-    //problem with zfp. In the block header I just write it's zfp, but I don't know the number of bitplanes
-    //so I am trying to get the full information from the field default_compression (example "zfp-64")
-    //TODO: can we be sure we will get the full specs always from default_compression? not so sure
-    if (compression == "zfp" && StringUtils::startsWith(query->field.default_compression, "zfp"))
-      compression = query->field.default_compression;
-#endif
+    auto failed = [&](SharedPtr<BlockQuery> query, String reason) {
 
-    //TODO: noninterruptile
-    auto decoded = ArrayUtils::decodeArray(compression, query->getNumberOfSamples(), query->field.dtype, encoded);
-    if (!decoded.valid())
-      return failed("cannot decode the data");
+      if (bVerbose)
+        PrintInfo("IdxDiskAccess::read blockid", query->blockid, "failed ", reason);
 
-    decoded.layout = layout;
+      return owner->readFailed(query, reason);
+    };
 
-    VisusAssert(decoded.dims == query->getNumberOfSamples());
-    query->buffer = decoded;
+    //all blocks must be in the same file (see IdxDiskAccess::readBlocks)
+    String filename = getFilename(queries[0]->field, queries[0]->time, queries[0]->blockid);
+    if (!openFile(filename, isWriting() ? "rw" : "r"))
+    {
+      for (auto query : queries)
+        failed(query, cstring("cannot open file", filename));
+      return;
+    }
 
-    if (bVerbose)
-      PrintInfo("Read block",blockid,"from file",file->getFilename(),"ok");
+    //sort blocks by offset in file
+    std::vector< std::pair<BlockHeader, SharedPtr<BlockQuery> > > blocks;
+    for (auto query : queries)
+    {
+      VisusAssert(getFilename(query->field, query->time, query->blockid) == filename);
 
-    owner->readOk(query);
+      if (query->aborted())
+      {
+        failed(query, "aborted");
+        continue;
+      }
+
+      const BlockHeader& block_header = getBlockHeader(query->field, query->blockid);
+      if (!block_header.getOffset() || !block_header.getSize())
+      {
+        failed(query, cstring("the idx data seeems not stored in the file", "block_offset", block_header.getOffset(), "block_size", block_header.getSize()));
+        continue;
+      }
+
+      blocks.push_back(std::make_pair(block_header, query));
+    }
+
+    std::sort(blocks.begin(), blocks.end(), [](const std::pair<BlockHeader, SharedPtr<BlockQuery> >& a, const std::pair<BlockHeader, SharedPtr<BlockQuery> >& b) {
+      return a.first.getOffset() < b.first.getOffset();
+    });
+
+    //merge contiguous (or almost contiguous) blocks in a single read
+    struct Range { int A, B; Int64 begin, end; SharedPtr<HeapMemory> buffer; };
+    std::vector<Range> ranges;
+    for (int A = 0, B = 0, N = (int)blocks.size(); A < N; A = B)
+    {
+      Int64 range_begin = blocks[A].first.getOffset();
+      Int64 range_end   = range_begin + blocks[A].first.getSize();
+      for (B = A + 1; B < N; B++)
+      {
+        Int64 offset = blocks[B].first.getOffset();
+        Int64 end    = offset + blocks[B].first.getSize();
+        if ((offset - range_end) > MaxCoalesceGap || (std::max(range_end, end) - range_begin) > MaxCoalesceSize)
+          break;
+        range_end = std::max(range_end, end);
+      }
+
+      if (bVerbose && B > A + 1)
+        PrintInfo("Coalesced read of", B - A, "blocks range_begin", range_begin, "range_end", range_end);
+
+      auto buffer = std::make_shared<HeapMemory>();
+      if (!buffer->resize(range_end - range_begin, __FILE__, __LINE__))
+      {
+        for (int I = A; I < B; I++)
+          failed(blocks[I].second, "cannot allocate encoded buffer");
+        continue;
+      }
+
+      ranges.push_back(Range{ A, B, range_begin, range_end, buffer });
+    }
+
+    //submit all ranges at once (i.e. they are all in flight at the same time with io_uring)
+    std::vector<File::ReadRequest> requests;
+    for (auto& range : ranges)
+      requests.push_back(File::ReadRequest(range.begin, range.buffer->c_size(), range.buffer->c_ptr()));
+    file->read(requests);
+
+    for (int R = 0; R < (int)ranges.size(); R++)
+    {
+      const auto& range = ranges[R];
+
+      if (!requests[R].ok)
+      {
+        for (int I = range.A; I < range.B; I++)
+          failed(blocks[I].second, "cannot read encoded buffer");
+        continue;
+      }
+
+      //single block, the buffer can be used as it is
+      if (range.B == range.A + 1)
+      {
+        decodeBlock(blocks[range.A].second, blocks[range.A].first, range.buffer);
+        continue;
+      }
+
+      //split the merged buffer (note: decodeBlock will not keep a reference to the merged buffer)
+      for (int I = range.A; I < range.B; I++)
+      {
+        const auto& block_header = blocks[I].first;
+        auto encoded = HeapMemory::createUnmanaged(range.buffer->c_ptr() + (block_header.getOffset() - range.begin), block_header.getSize());
+        decodeBlock(blocks[I].second, block_header, encoded, /*bEncodedIsView*/true);
+      }
+    }
   }
 
   //writeBlock
-  virtual void writeBlock(SharedPtr<BlockQuery> query) override
+  virtual void writeBlock(SharedPtr<BlockQuery> query) override {
+    writeEncodedBlock(query, encodeBlock(query));
+  }
+
+  //encodeBlock (does not touch the file, so it can run in parallel)
+  SharedPtr<HeapMemory> encodeBlock(SharedPtr<BlockQuery> query) const {
+    return ArrayUtils::encodeArray(owner->getCompressionSpecs(query->field, query->field.default_compression), query->buffer);
+  }
+
+  //writeEncodedBlock
+  void writeEncodedBlock(SharedPtr<BlockQuery> query, SharedPtr<HeapMemory> encoded)
   {
     BigInt blockid = query->blockid;
 
@@ -546,10 +776,8 @@ public:
       return failed("Failed to write block, input arguments are wrong");
     }
 
-    //encode the data
+    //data encoded by encodeBlock
     String compression = query->field.default_compression;
-    auto decoded = query->buffer;
-    auto encoded = ArrayUtils::encodeArray(compression, decoded);
     if (!encoded)
     {
       VisusAssert(false);
@@ -559,7 +787,8 @@ public:
     BlockHeader block_header;
     block_header.setLayout(query->buffer.layout);
     block_header.setSize((Int32)encoded->c_size());
-    block_header.setCompression(compression);
+    if (!block_header.setCompression(compression))
+      return failed(cstring("unsupported compression", compression));
 
     String filename = getFilename(query->field, query->time, blockid);
     if (!openFile(filename, "rw"))
@@ -638,6 +867,12 @@ public:
 
 private:
 
+  //reads of blocks closer than this are merged
+  static const Int64 MaxCoalesceGap = 64 * 1024;
+
+  //max size of a merged read
+  static const Int64 MaxCoalesceSize = 16 * 1024 * 1024;
+
   enum
   {
     NoCompression = 0,
@@ -647,6 +882,7 @@ private:
     PngCompression = 0x06,
     Lz4Compression = 0x07,
     ZfpCompression = 0x08,    
+    ZstdCompression = 0x09,
     CompressionMask = 0x0f
   };
 
@@ -655,6 +891,14 @@ private:
     FormatRowMajor = 0x10
   };
 
+  //lossless pre-filters applied before the compression (see FilterEncoder)
+  enum
+  {
+    ShuffleFilter    = 0x20,
+    BitShuffleFilter = 0x40,
+    DeltaFilter      = 0x80
+  };
+
   //___________________________________________
   class FileHeader
   {
@@ -733,28 +977,50 @@ private:
     //getCompression
     String getCompression() const {
 
+      String filters;
+      if (flags & DeltaFilter)      filters += "delta+";
+      if (flags & ShuffleFilter)    filters += "shuffle+";
+      if (flags & BitShuffleFilter) filters += "bitshuffle+";
+
       switch (flags & CompressionMask)
       {
-        case NoCompression: return ""; break;
-        case Lz4Compression:return "lz4"; break;
-        case ZipCompression:return "zip"; break;
+        case NoCompression: return filters.empty()? "" : filters + "raw"; break;
+        case Lz4Compression:return filters + "lz4"; break;
+        case ZipCompression:return filters + "zip"; break;
         case JpgCompression:return "jpg"; break;
         case PngCompression:return "png"; break;
         case ZfpCompression:return "zfp"; break;
+        case ZstdCompression:return filters + "zstd"; break;
         default: VisusAssert(false); return "";
       }
     }
 
-    //setCompression
-    void setCompression(String value) 
+    //setCompression (example "shuffle+lz4"), false if the header cannot represent it
+    bool setCompression(String value) 
     {
-      if      (value.empty())  flags |= NoCompression;
+      auto tokens = StringUtils::split(value, "+");
+      for (; !tokens.empty(); tokens.erase(tokens.begin()))
+      {
+        if      (tokens[0] == "delta"     ) flags |= DeltaFilter;
+        else if (tokens[0] == "shuffle"   ) flags |= ShuffleFilter;
+        else if (tokens[0] == "bitshuffle") flags |= BitShuffleFilter;
+        else break;
+      }
+      value = StringUtils::join(tokens, "+");
+
+      //filters are stored only for lossless codecs (see getCompression and FilterEncoder)
+      bool bFilters = (flags & (DeltaFilter | ShuffleFilter | BitShuffleFilter)) != 0;
+
+      if      (value.empty() || value == "raw")  flags |= NoCompression;
       else if (StringUtils::startsWith(value, "lz4")) flags |= Lz4Compression;
       else if (StringUtils::startsWith(value, "zip")) flags |= ZipCompression;
+      else if (StringUtils::startsWith(value, "zstd")) flags |= ZstdCompression;
+      else if (bFilters) return false;
       else if (StringUtils::startsWith(value, "jpg")) flags |= JpgCompression;
       else if (StringUtils::startsWith(value, "png")) flags |= PngCompression;
       else if (StringUtils::startsWith(value, "zfp")) flags |= ZfpCompression;
-      else VisusAssert(false);
+      else return false;
+      return true;
     }
 
   };
@@ -776,6 +1042,65 @@ private:
     return block_headers[cint(field.index)*idxfile.blocksperfile + idxfile.getBlockPositionInFile(blockid)];
   }
 
+  //decodeBlock
+  void decodeBlock(SharedPtr<BlockQuery> query, const BlockHeader& block_header, SharedPtr<HeapMemory> encoded, bool bEncodedIsView = false)
+  {
+    auto failed = [&](String reason) {
+
+      if (bVerbose)
+        PrintInfo("IdxDiskAccess::read blockid", query->blockid, "failed ", reason);
+
+      return owner->readFailed(query, reason);
+    };
+
+    String compression = block_header.getCompression();
+    String layout      = block_header.getLayout();
+
+    if (bVerbose)
+      PrintInfo("Decoding buffer");
+
+    if (query->aborted())
+      return failed("aborted");
+
+#if 1
+    //problem with zfp. In the block header I just write it's zfp, but I don't know the number of bitplanes
+    //so I am trying to get the full information from the field default_compression (example "zfp-64")
+    //TODO: can we be sure we will get the full specs always from default_compression? not so sure
+    if (compression == "zfp" && StringUtils::startsWith(query->field.default_compression, "zfp"))
+      compression = query->field.default_compression;
+#endif
+
+    compression = owner->getCompressionSpecs(query->field, compression);
+
+    //the caller wants the block as stored (for example mod_visus sending it without decoding/encoding)
+    if (query->accept_encoded)
+    {
+      query->encoded = bEncodedIsView ? encoded->clone() : encoded;
+      query->encoded_compression = compression;
+      query->encoded_layout = layout;
+      return owner->readOk(query);
+    }
+
+    //TODO: noninterruptile
+    auto decoded = ArrayUtils::decodeArray(compression, query->getNumberOfSamples(), query->field.dtype, encoded);
+    if (!decoded.valid())
+      return failed("cannot decode the data");
+
+    //the encoded buffer can be a view of a coalesced read (i.e. the decoded array must own its memory)
+    if (bEncodedIsView && decoded.heap == encoded)
+      decoded = decoded.clone();
+
+    decoded.layout = layout;
+
+    VisusAssert(decoded.dims == query->getNumberOfSamples());
+    query->buffer = decoded;
+
+    if (bVerbose)
+      PrintInfo("Read block", query->blockid, "from file", file->getFilename(), "ok");
+
+    owner->readOk(query);
+  }
+
   //openFile
   bool openFile(String filename, String file_mode)
   {
@@ -792,9 +1117,20 @@ private:
     if (bVerbose)
       PrintInfo("Opening file",filename,"mode", file_mode);
 
+    //I am going to change the file, any cached header will be wrong
+    bool bWriting = StringUtils::contains(file_mode, "w");
+    if (bWriting)
+      IdxHeaderCache::getSingleton()->invalidate(filename);
+
     //already exist
     if (this->file->open(filename, file_mode))
     {
+      //already decoded by some other access
+      Int64 mtime = bWriting ? 0 : FileUtils::getTimeLastModified(filename);
+      Int64 filesize = bWriting ? 0 : this->file->size();
+      if (!bWriting && IdxHeaderCache::getSingleton()->get(filename, mtime, filesize, this->headers))
+        return true;
+
       //read the headers
       if (!this->file->read(0, this->headers.c_size(), this->headers.c_ptr()))
       {
@@ -810,6 +1146,9 @@ private:
           ptr[I] = ByteOrder::swapByteOrder(ptr[I]);
       }
 
+      if (!bWriting)
+        IdxHeaderCache::getSingleton()->put(filename, mtime, filesize, this->headers);
+
       return true;
     }
 
@@ -869,6 +1208,9 @@ private:
         if (bVerbose)
           PrintInfo("cannot write headers");
       }
+
+      //some other access could have cached the headers in the meantime
+      IdxHeaderCache::getSingleton()->invalidate(this->file->getFilename());
     }
 
     this->file->close();
@@ -935,8 +1277,7 @@ IdxDiskAccess::IdxDiskAccess(IdxDataset* dataset,IdxFile idxfile, StringTree con
       return new IdxDiskAccessV6(this, idxfile, resoveAlias(idxfile.time_template), resoveAlias(idxfile.filename_template), bVerbose);
   };
 
-  this-> sync.reset(createAccess());
-  this->async.reset(createAccess());
+  this->sync.reset(createAccess());
 
   //set this only if you know what you are doing (example visus convert with only one process)
   this->bDisableWriteLocks = 
@@ -955,6 +1296,33 @@ IdxDiskAccess::IdxDiskAccess(IdxDataset* dataset,IdxFile idxfile, StringTree con
   //if (this->bDisableWriteLocks)
   //  PrintInfo("IdxDiskAccess::IdxDiskAccess disabling write locsk. be careful");
 
+  //compression dictionaries, registered by content so that different versions can coexist
+  if (url.isFile())
+  {
+    for (auto field : idxfile.fields)
+    {
+      auto filename = getDictionaryFilename(url.getPath(), field);
+      if (!FileUtils::existsFile(filename))
+        continue;
+
+      auto content = Utils::loadBinaryDocument(filename);
+      if (!content)
+        continue;
+
+      auto name = StringUtils::md5(String((const char*)content->c_ptr(), (size_t)content->c_size()));
+      Encoders::getSingleton()->setDictionary(name, content);
+      this->dictionaries[field.name] = name;
+
+      if (bVerbose)
+        PrintInfo("IdxDiskAccess loaded compression dictionary", filename, "field", field.name);
+    }
+  }
+
+  //number of threads encoding blocks in writeBlocks
+  this->write_nthreads = config.readInt("write_nthreads", std::max(1, (int)std::thread::hardware_concurrency()));
+  if (auto env = getenv("VISUS_IDX_WRITE_NTHREADS"))
+    this->write_nthreads = cint(String(env));
+
   
 #if 1
   bool disable_async=false;
@@ -963,17 +1331,55 @@ IdxDiskAccess::IdxDiskAccess(IdxDataset* dataset,IdxFile idxfile, StringTree con
   else
     disable_async = config.readBool("disable_async", dataset->isServerMode());
 
-  // important!number of threads must be <=1 
-  if (int nthreads = disable_async ? 0 : 1)
+  //each worker gets its own reader (i.e. its own file handle and headers) so that block reads and decodes can run in parallel
+  int nthreads = config.readInt("nthreads", 1);
+  if (auto env = getenv("VISUS_IDX_NTHREADS"))
+    nthreads = cint(String(env));
+
+  if (nthreads < 0)
+    nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+
+  if (disable_async)
+    nthreads = 0;
+
+  if (nthreads)
   {
+    for (int I = 0; I < nthreads; I++)
+    {
+      this->async.push_back(SharedPtr<Access>(createAccess()));
+      this->async_idle.push_back(std::make_pair(this->async.back().get(), String()));
+    }
+
     async_tpool = std::make_shared<ThreadPool>("IdxDiskAccess Thread", nthreads);
   }
 #endif
 
   if (bVerbose)
-    PrintInfo("IdxDiskAccess created url",url,"async",async_tpool?"yes":"no");
+    PrintInfo("IdxDiskAccess created url",url,"async",async_tpool?"yes":"no","nthreads",nthreads);
 }
 
+
+////////////////////////////////////////////////////////////////////
+String IdxDiskAccess::getDictionaryFilename(String idx_filename, Field field)
+{
+  Path path(idx_filename);
+  return path.getParent().getChild(path.getFileNameWithoutExtension() + "." + StringUtils::encodeForFilename(field.name) + ".dict").toString();
+}
+
+////////////////////////////////////////////////////////////////////
+String IdxDiskAccess::getCompressionSpecs(Field field, String compression) const
+{
+  auto it = dictionaries.find(field.name);
+  if (it == dictionaries.end())
+    return compression;
+
+  //only zstd supports dictionaries for now, it's the last codec (example "shuffle+zstd-19")
+  auto tokens = StringUtils::split(compression, "+");
+  if (tokens.empty() || !StringUtils::startsWith(tokens.back(), "zstd"))
+    return compression;
+
+  return compression + "-dict=" + it->second;
+}
 
 ////////////////////////////////////////////////////////////////////
 IdxDiskAccess::IdxDiskAccess(IdxDataset* dataset, StringTree config)
@@ -992,6 +1398,12 @@ IdxDiskAccess::~IdxDiskAccess()
     async_tpool.reset();
   }
 
+  if (write_tpool)
+  {
+    write_tpool->waitAll();
+    write_tpool.reset();
+  }
+
   //scrgiorgio: I have a problem here, don't know why
   //VisusReleaseAssert(!isReading() && !isWriting());
 }
@@ -1024,11 +1436,11 @@ void IdxDiskAccess::beginIO(int mode)
 
   Access::beginIO(mode);
 
+  //NOTE: no async job is running here, so it's safe to call it from this thread
   if (!isWriting() && async_tpool)
   {
-    ThreadPool::push(async_tpool, [this, mode]() {
-      async->beginIO(mode);
-    });
+    for (auto reader : async)
+      reader->beginIO(mode);
   }
   else
   {
@@ -1041,10 +1453,10 @@ void IdxDiskAccess::endIO()
 {
   if (!isWriting() && async_tpool)
   {
-    ThreadPool::push(async_tpool, [this]() {
-      async->endIO();
-    });
+    //wait for all pending reads before closing the readers' files
     async_tpool->waitAll();
+    for (auto reader : async)
+      reader->endIO();
   }
   else
   {
@@ -1086,7 +1498,10 @@ void IdxDiskAccess::readBlock(SharedPtr<BlockQuery> query)
   if (bool bAsync = !isWriting() && async_tpool)
   {
     ThreadPool::push(async_tpool, [this, query]() {
-      return async->readBlock(query);
+      auto filename = getFilename(query->field, query->time, query->blockid);
+      auto reader = acquireAsyncReader(filename);
+      reader->readBlock(query);
+      releaseAsyncReader(reader, filename);
     });
   }
   else
@@ -1096,6 +1511,87 @@ void IdxDiskAccess::readBlock(SharedPtr<BlockQuery> query)
 }
 
 
+////////////////////////////////////////////////////////////////////
+void IdxDiskAccess::readBlocks(std::vector< SharedPtr<BlockQuery> > queries)
+{
+  VisusAssert(isReading() || isWriting());
+
+  if (bSkipReading)
+  {
+    for (auto query : queries)
+      readBlock(query);
+    return;
+  }
+
+  //group by file
+  std::map<String, std::vector< SharedPtr<BlockQuery> > > groups;
+  for (auto query : queries)
+  {
+    if (query->blockid < 0)
+      readBlock(query); //will fail
+    else
+      groups[getFilename(query->field, query->time, query->blockid)].push_back(query);
+  }
+
+  for (auto it : groups)
+  {
+    auto filename = it.first;
+    auto group = it.second;
+
+    if (!isWriting() && async_tpool)
+    {
+      //split the group in chunks, so that all workers can read/decode in parallel
+      int chunk_size = std::max(1, (int)((group.size() + async.size() - 1) / async.size()));
+      for (int I = 0; I < (int)group.size(); I += chunk_size)
+      {
+        auto chunk = std::vector< SharedPtr<BlockQuery> >(group.begin() + I, group.begin() + std::min((int)group.size(), I + chunk_size));
+        ThreadPool::push(async_tpool, [this, filename, chunk]() {
+          auto reader = acquireAsyncReader(filename);
+          reader->readBlocks(chunk);
+          releaseAsyncReader(reader, filename);
+        });
+      }
+    }
+    else
+    {
+      sync->readBlocks(group);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+Access* IdxDiskAccess::acquireAsyncReader(String filename)
+{
+  ScopedLock lock(async_lock);
+
+  //there is one reader per worker, so I must have one idle here
+  VisusReleaseAssert(!async_idle.empty());
+
+  //prefer a reader that has already opened the file (avoid to close/open and reread the headers)
+  int index = 0;
+  for (int I = 0; I < (int)async_idle.size(); I++)
+  {
+    if (async_idle[I].second == filename)
+    {
+      index = I;
+      break;
+    }
+  }
+
+  auto ret = async_idle[index].first;
+  async_idle.erase(async_idle.begin() + index);
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxDiskAccess::releaseAsyncReader(Access* reader, String filename)
+{
+  ScopedLock lock(async_lock);
+
+  //least recently used at the beginning
+  async_idle.push_back(std::make_pair(reader, filename));
+}
+
 ////////////////////////////////////////////////////////////////////
 void IdxDiskAccess::writeBlock(SharedPtr<BlockQuery> query)
 {
@@ -1118,6 +1614,56 @@ void IdxDiskAccess::writeBlock(SharedPtr<BlockQuery> query)
   releaseWriteLock(query);
 }
 
+///////////////////////////////////////////////////////
+void IdxDiskAccess::writeBlocks(std::vector< SharedPtr<BlockQuery> > queries)
+{
+  VisusAssert(isWriting());
+
+  auto writer = dynamic_cast<IdxDiskAccessV6*>(sync.get());
+  if (bSkipWriting || !writer || queries.size() <= 1 || write_nthreads <= 1)
+  {
+    for (auto query : queries)
+      writeBlock(query);
+    return;
+  }
+
+  //encoding is the expensive part and does not touch the file, so it runs in parallel
+  if (!write_tpool)
+    write_tpool = std::make_shared<ThreadPool>("IdxDiskAccess Writer", write_nthreads);
+
+  std::vector< SharedPtr<HeapMemory> > encoded(queries.size());
+  for (int I = 0; I < (int)queries.size(); I++)
+  {
+    ThreadPool::push(write_tpool, [&encoded, &queries, writer, I]() {
+      encoded[I] = writer->encodeBlock(queries[I]);
+    });
+  }
+  write_tpool->waitAll();
+
+  //only the file append and header update are serial, grouped by file (the writer keeps only one file open)
+  std::vector<int> order(queries.size());
+  std::vector<String> filenames(queries.size());
+  for (int I = 0; I < (int)queries.size(); I++)
+  {
+    order[I] = I;
+    filenames[I] = getFilename(queries[I]->field, queries[I]->time, queries[I]->blockid);
+  }
+  std::stable_sort(order.begin(), order.end(), [&filenames](int a, int b) {
+    return filenames[a] < filenames[b];
+  });
+
+  for (auto I : order)
+  {
+    if (bVerbose)
+      PrintInfo("got request to write block blockid", queries[I]->blockid);
+
+    acquireWriteLock(queries[I]);
+    writer->writeEncodedBlock(queries[I], encoded[I]);
+    releaseWriteLock(queries[I]);
+    encoded[I].reset();
+  }
+}
+
 
 ///////////////////////////////////////////////////////
 void IdxDiskAccess::acquireWriteLock(SharedPtr<BlockQuery> query)
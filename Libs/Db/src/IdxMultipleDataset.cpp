@@ -375,6 +375,8 @@ bool IdxMultipleDataset::executeBoxQuery(SharedPtr<Access> ACCESS,SharedPtr<BoxQ
 
 ////////////////////////////////////////////////////////////////////////
 void IdxMultipleDataset::beginBoxQuery(SharedPtr<BoxQuery> query) {
+  //the output is blended from the down queries, cannot refine in place
+  if (query) query->inplace.enabled = false;
   return IdxDataset::beginBoxQuery(query);
 }
 
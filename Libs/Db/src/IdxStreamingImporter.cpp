@@ -0,0 +1,422 @@
+/*-----------------------------------------------------------------------------
+Copyright(c) 2010 - 2018 ViSUS L.L.C.,
+Scientific Computing and Imaging Institute of the University of Utah
+
+ViSUS L.L.C., 50 W.Broadway, Ste. 300, 84101 - 2044 Salt Lake City, UT
+University of Utah, 72 S Central Campus Dr, Room 3750, 84112 Salt Lake City, UT
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met :
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+For additional information about this project contact : pascucci@acm.org
+For support : support@visus.net
+-----------------------------------------------------------------------------*/
+
+#include <Visus/IdxStreamingImporter.h>
+#include <Visus/IdxDataset.h>
+#include <Visus/IdxDiskAccess.h>
+
+namespace Visus {
+
+////////////////////////////////////////////////////////////////////
+IdxStreamingImporter::IdxStreamingImporter(IdxDataset* db_, Field field_, double time_, std::vector<String> compression_)
+  : db(db_), field(field_), time(time_), compression(compression_)
+{
+  VisusReleaseAssert(db && field.valid());
+
+  this->logic_box = db->getLogicBox();
+  this->axis = logic_box.getPointDim() - 1;
+  this->next_slice = logic_box.p1[axis];
+
+  //example ["zip","jpeg","jpeg"] means last level "jpeg", last-level-minus-one "jpeg" all others zip (like compressDataset)
+  int nlevels = db->getMaxResolution() + 1;
+  if (compression.empty())
+    compression = { field.default_compression };
+  VisusReleaseAssert((int)compression.size() <= nlevels);
+  while ((int)compression.size() < nlevels)
+    compression.insert(compression.begin(), compression.front());
+
+  if (auto env = getenv("VISUS_IMPORT_NTHREADS"))
+    this->nthreads = cint(String(env));
+}
+
+////////////////////////////////////////////////////////////////////
+IdxStreamingImporter::~IdxStreamingImporter()
+{
+  if (access)
+  {
+    PrintWarning("IdxStreamingImporter destroyed without endImport, pending blocks are lost");
+    access->endWrite();
+  }
+  closeSpillFile();
+}
+
+////////////////////////////////////////////////////////////////////
+PointNi IdxStreamingImporter::getSlabDims(Int64 nslices) const
+{
+  auto ret = logic_box.size();
+  ret[axis] = nslices;
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::beginImport()
+{
+  VisusReleaseAssert(!access);
+
+  if (db->idxfile.version != 6)
+    ThrowException("unsupported");
+
+  access = std::make_shared<IdxDiskAccess>(db);
+  access->disableWriteLock();
+  access->disableAsync();
+  access->beginWrite();
+
+  int num_workers = nthreads > 0 ? nthreads : std::max(1, (int)std::thread::hardware_concurrency());
+  if (num_workers > 1)
+    tpool = std::make_shared<ThreadPool>("IdxStreamingImporter Worker", num_workers);
+
+  this->next_slice = logic_box.p1[axis];
+  this->t1 = this->last_print = Time::now();
+  this->spill_filename = concatenate(Url(db->getUrl()).getPath(), ".~import.", field.name);
+}
+
+////////////////////////////////////////////////////////////////////
+SharedPtr<BlockQuery> IdxStreamingImporter::createBlock(BigInt blockid)
+{
+  auto ret = db->createBlockQuery(blockid, field, time, 'w');
+
+  //compression can depend on level
+  VisusReleaseAssert(ret->H >= 0 && ret->H < (int)compression.size());
+  ret->field.default_compression = compression[ret->H];
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+bool IdxStreamingImporter::isBlockComplete(SharedPtr<BlockQuery> block) const
+{
+  //samples outside the dataset will never come
+  auto end_slice = std::min(block->getLogicBox().p2[axis], logic_box.p2[axis]);
+  return next_slice >= end_slice;
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::writeBlocks(std::vector< SharedPtr<BlockQuery> > blocks)
+{
+  if (blocks.empty())
+    return;
+
+  //IdxDiskAccess encodes in parallel and serializes only the file writes
+  db->executeBlockQueries(access, blocks);
+
+  for (auto block : blocks)
+  {
+    block->done.get();
+    if (block->failed())
+      ThrowException("cannot write block", block->blockid, block->errormsg);
+
+    pending_bytes -= block->getByteSize();
+    pending.erase(block->blockid);
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::spillBlocks(std::vector< SharedPtr<BlockQuery> > blocks)
+{
+  if (blocks.empty())
+    return;
+
+  //raw samples, never the dataset files (a spilled block would leave garbage in them, and lossy codecs would re-encode it)
+  if (!spill_file.isOpen())
+  {
+    FileUtils::removeFile(spill_filename);
+    if (!spill_file.createAndOpen(spill_filename, "rw"))
+      ThrowException("cannot create spill file", spill_filename);
+  }
+
+  for (auto block : blocks)
+  {
+    auto it = spilled.find(block->blockid);
+    if (it == spilled.end())
+    {
+      it = spilled.insert(std::make_pair(block->blockid, Spilled())).first;
+      it->second.offset = spill_size;
+      spill_size += block->getByteSize();
+    }
+
+    auto& slot = it->second;
+    VisusReleaseAssert(block->buffer.c_size() == block->getByteSize());
+    if (!spill_file.write(slot.offset, block->buffer.c_size(), block->buffer.c_ptr()))
+      ThrowException("cannot write spill file", spill_filename);
+    slot.layout = block->buffer.layout;
+    slot.bInFile = true;
+
+    pending_bytes -= block->getByteSize();
+    pending.erase(block->blockid);
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::reloadBlocks(std::vector< SharedPtr<BlockQuery> > blocks)
+{
+  std::vector<File::ReadRequest> requests;
+  for (auto block : blocks)
+  {
+    auto& slot = spilled[block->blockid];
+    VisusReleaseAssert(slot.bInFile);
+    block->allocateBufferIfNeeded();
+    block->buffer.layout = slot.layout;
+    slot.bInFile = false;
+    requests.push_back(File::ReadRequest(slot.offset, block->buffer.c_size(), block->buffer.c_ptr()));
+  }
+
+  if (!requests.empty() && !spill_file.read(requests))
+    ThrowException("cannot read spill file", spill_filename);
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::closeSpillFile()
+{
+  if (spill_file.isOpen())
+  {
+    spill_file.close();
+    FileUtils::removeFile(spill_filename);
+  }
+  spilled.clear();
+  spill_size = 0;
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::importSlab(Array slab)
+{
+  VisusReleaseAssert(access);
+
+  if (slab.dtype != field.dtype)
+    ThrowException("wrong slab dtype", slab.dtype, "expecting", field.dtype);
+
+  auto nslices = slab.dims.getPointDim() == logic_box.getPointDim() ? slab.dims[axis] : 0;
+  if (nslices <= 0 || slab.dims != getSlabDims(nslices))
+    ThrowException("wrong slab dims", slab.dims, "expecting", getSlabDims(nslices));
+
+  auto slab_box = logic_box;
+  slab_box.p1[axis] = next_slice;
+  slab_box.p2[axis] = next_slice + nslices;
+  if (slab_box.p2[axis] > logic_box.p2[axis])
+    ThrowException("slab out of logic box", slab_box, logic_box);
+
+  auto query = db->createBoxQuery(slab_box, field, time, 'w');
+  db->beginBoxQuery(query);
+  if (!query->isRunning())
+    ThrowException("cannot begin box query", query->errormsg);
+  VisusReleaseAssert(query->getNumberOfSamples() == slab.dims);
+  query->buffer = slab;
+
+  auto blockids = db->createBlockQueriesForBoxQuery(query);
+
+  std::vector< SharedPtr<BlockQuery> > blocks, reload;
+  for (auto blockid : blockids)
+  {
+    auto it = pending.find(blockid);
+    if (it != pending.end())
+    {
+      blocks.push_back(it->second);
+      continue;
+    }
+
+    auto block = createBlock(blockid);
+
+    //spilled, need to merge on top of the samples already imported
+    if (isSpilled(blockid))
+      reload.push_back(block);
+
+    pending[blockid] = block;
+    pending_bytes += block->getByteSize();
+    blocks.push_back(block);
+  }
+
+  reloadBlocks(reload);
+
+  //blocks are disjoint, so they can be merged concurrently
+  auto mergeBlock = [this, query](SharedPtr<BlockQuery> block) {
+    block->allocateBufferIfNeeded();
+    db->mergeBoxQueryWithBlockQuery(query, block);
+  };
+
+  if (tpool && blocks.size() > 1)
+  {
+    for (auto block : blocks)
+      ThreadPool::push(tpool, [mergeBlock, block]() {mergeBlock(block); });
+    tpool->waitAll();
+  }
+  else
+  {
+    for (auto block : blocks)
+      mergeBlock(block);
+  }
+
+  next_slice += nslices;
+  nbytes_in += slab.c_size();
+  peak_bytes = std::max(peak_bytes, pending_bytes);
+
+  //flush completed blocks
+  std::vector< SharedPtr<BlockQuery> > completed;
+  for (auto it : pending)
+  {
+    if (isBlockComplete(it.second))
+      completed.push_back(it.second);
+  }
+  nwritten += (Int64)completed.size();
+  writeBlocks(completed);
+
+  //too much memory: spill the coarsest blocks (the ones with the biggest delta along the slab axis are touched less often)
+  if (max_memory > 0 && pending_bytes > max_memory)
+  {
+    std::vector< SharedPtr<BlockQuery> > candidates;
+    for (auto it : pending)
+      candidates.push_back(it.second);
+
+    std::stable_sort(candidates.begin(), candidates.end(), [this](const SharedPtr<BlockQuery>& a, const SharedPtr<BlockQuery>& b) {
+      return a->logic_samples.delta[axis] > b->logic_samples.delta[axis];
+    });
+
+    std::vector< SharedPtr<BlockQuery> > to_spill;
+    Int64 nbytes = pending_bytes;
+    for (auto block : candidates)
+    {
+      if (nbytes <= max_memory / 2)
+        break;
+      nbytes -= block->getByteSize();
+      to_spill.push_back(block);
+    }
+
+    if (!nspilled)
+      PrintWarning("IdxStreamingImporter max_memory", StringUtils::getStringFromByteSize(max_memory), "reached, spilling partial blocks to disk");
+
+    nspilled += (Int64)to_spill.size();
+    spillBlocks(to_spill);
+  }
+
+  if (bVerbose && last_print.elapsedSec() > 5.0)
+  {
+    printStatistics("Importing");
+    last_print = Time::now();
+  }
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::endImport()
+{
+  VisusReleaseAssert(access);
+
+  if (!isComplete())
+    PrintWarning("IdxStreamingImporter ended at slice", next_slice, "expecting", logic_box.p2[axis], "missing samples will be written as default value");
+
+  std::vector< SharedPtr<BlockQuery> > remaining;
+  for (auto it : pending)
+    remaining.push_back(it.second);
+  nwritten += (Int64)remaining.size();
+  writeBlocks(remaining);
+  VisusAssert(pending.empty() && pending_bytes == 0);
+
+  //spilled blocks not touched by the last slabs (in batches, to stay within max_memory)
+  std::vector<BigInt> blockids;
+  for (auto it : spilled)
+  {
+    if (it.second.bInFile)
+      blockids.push_back(it.first);
+  }
+
+  for (int I = 0; I < (int)blockids.size(); )
+  {
+    std::vector< SharedPtr<BlockQuery> > batch;
+    Int64 batch_bytes = 0;
+    for (; I < (int)blockids.size() && (batch.empty() || max_memory <= 0 || batch_bytes < max_memory / 2); I++)
+    {
+      auto block = createBlock(blockids[I]);
+      pending[block->blockid] = block;
+      pending_bytes += block->getByteSize();
+      batch_bytes += block->getByteSize();
+      batch.push_back(block);
+    }
+    reloadBlocks(batch);
+    nwritten += (Int64)batch.size();
+    writeBlocks(batch);
+  }
+  VisusAssert(pending.empty() && pending_bytes == 0);
+
+  access->endWrite();
+  access.reset();
+  tpool.reset();
+  closeSpillFile();
+
+  if (bVerbose)
+    printStatistics("Import done");
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::printStatistics(String msg)
+{
+  auto sec = std::max(0.001, t1.elapsedSec());
+  PrintInfo(msg,
+    "slice", next_slice - logic_box.p1[axis], "/", logic_box.size()[axis],
+    "read", StringUtils::getStringFromByteSize(nbytes_in),
+    "MB/sec", (nbytes_in / (1024.0 * 1024.0)) / sec,
+    "written-blocks", nwritten,
+    "pending-blocks", (Int64)pending.size(),
+    "pending-memory", StringUtils::getStringFromByteSize(pending_bytes),
+    "peak-memory", StringUtils::getStringFromByteSize(peak_bytes),
+    "spilled-blocks", nspilled);
+}
+
+////////////////////////////////////////////////////////////////////
+void IdxStreamingImporter::importArray(IdxDataset* db, Array data, std::vector<String> compression, Int64 slab_size)
+{
+  IdxStreamingImporter importer(db, db->getField(), db->getTime(), compression);
+
+  auto logic_box = db->getLogicBox();
+  int axis = logic_box.getPointDim() - 1;
+  if (data.dims != logic_box.size())
+    ThrowException("wrong data dims", data.dims, "expecting", logic_box.size());
+
+  auto slice_size = data.dtype.getByteSize(importer.getSlabDims(1));
+  VisusReleaseAssert(slice_size * data.dims[axis] == data.c_size());
+  auto nslices = Utils::clamp(slab_size / slice_size, (Int64)1, data.dims[axis]);
+
+  importer.beginImport();
+  for (Int64 Z = 0; Z < data.dims[axis]; Z += nslices)
+  {
+    auto slab_dims = importer.getSlabDims(std::min(nslices, data.dims[axis] - Z));
+
+    //row major: the slab is a contiguous piece of the input
+    auto slab = Array(slab_dims, data.dtype, HeapMemory::createUnmanaged(data.c_ptr() + Z * slice_size, data.dtype.getByteSize(slab_dims)));
+    importer.importSlab(slab);
+  }
+  importer.endImport();
+}
+
+} //namespace Visus
+
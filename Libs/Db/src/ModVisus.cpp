@@ -609,19 +609,44 @@ NetResponse ModVisus::handleBlockQuery(const NetRequest& request)
   access->beginRead();
   Aborted aborted;
 
-  std::vector<NetResponse> responses;
-  for (auto blockid : blocks)
+  //done callbacks can run concurrently on several reader threads, each one writes only its own slot (in the order of blocks)
+  std::vector<NetResponse> responses(blocks.size());
+  for (int I = 0; I < (int)blocks.size(); I++)
   {
-    auto block_query = dataset->createBlockQuery(blockid, field, time, 'r', aborted);
+    auto block_query = dataset->createBlockQuery(blocks[I], field, time, 'r', aborted);
+    block_query->accept_encoded = true;
     dataset->executeBlockQuery(access, block_query);
-    wait_async.pushRunning(block_query->done,[block_query, &responses, dataset, compression, rowmajor](Void) {
+    wait_async.pushRunning(block_query->done,[I, block_query, &responses, dataset, compression, rowmajor](Void) {
 
       if (block_query->failed())
       {
-        responses.push_back(NetResponseError(HttpStatus::STATUS_NOT_FOUND, "block_query->executeAndWait failed"));
+        responses[I] = NetResponseError(HttpStatus::STATUS_NOT_FOUND, "block_query->executeAndWait failed");
         return;
       }
 
+      //the access returned the block as stored on disk
+      if (block_query->encoded)
+      {
+        //compressed passthrough, no need to decode/encode
+        if (block_query->encoded_compression == compression && (!rowmajor || block_query->encoded_layout.empty()))
+        {
+          NetResponse response(HttpStatus::STATUS_OK);
+          response.setEncodedArrayBody(compression, block_query->getNumberOfSamples(), block_query->field.dtype, block_query->encoded_layout, block_query->encoded);
+          responses[I] = response;
+          return;
+        }
+
+        auto decoded = ArrayUtils::decodeArray(block_query->encoded_compression, block_query->getNumberOfSamples(), block_query->field.dtype, block_query->encoded);
+        if (!decoded.valid())
+        {
+          responses[I] = NetResponseError(HttpStatus::STATUS_INTERNAL_SERVER_ERROR, "cannot decode the block");
+          return;
+        }
+        decoded.layout = block_query->encoded_layout;
+        block_query->buffer = decoded;
+        block_query->encoded.reset();
+      }
+
       //by default i return the block as it is,unless the users specified rowmajor in headers
       if (rowmajor)
         dataset->convertBlockQueryToRowMajor(block_query);
@@ -630,11 +655,11 @@ NetResponse ModVisus::handleBlockQuery(const NetRequest& request)
       NetResponse response(HttpStatus::STATUS_OK);
       if (!response.setArrayBody(compression, block_query->buffer))
       {
-        responses.push_back(NetResponseError(HttpStatus::STATUS_INTERNAL_SERVER_ERROR, "Encoding converting to row major failed"));
+        responses[I] = NetResponseError(HttpStatus::STATUS_INTERNAL_SERVER_ERROR, "Encoding converting to row major failed");
         return;
       }
 
-      responses.push_back(response);
+      responses[I] = response;
     });
   }
   access->endRead();
@@ -39,13 +39,22 @@ For support : support@visus.net
 #include <Visus/RamAccess.h>
 #include <Visus/Dataset.h>
 
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+
 namespace Visus {
 
 ////////////////////////////////////////////////////////////////////
+//NOTE: blocks are split in independent shards (each one with its own lock and eviction policy) so that concurrent readers 
+//do not serialize on a single mutex. Buffers are cloned on insert (the writer can own, reuse or free its memory, for example
+//a numpy array) but shared (not cloned) with the queries on hits, so cached blocks must be considered immutable
 class RamAccess::Shared 
 {
 public:
 
+  enum { MaxLevels = 64, ProtectedLevels = 6 };
+
   //_____________________________________________________________
   class Key
   {
@@ -63,17 +72,25 @@ public:
     inline bool operator==(const Key& other) const 
     {return blockid ==other.blockid && time==other.time && fieldname==other.fieldname;}
 
-    //operator<
-    inline bool operator<(const Key& other) const 
+    //valid
+    inline bool valid() const
+    {return blockid >=0 && !fieldname.empty();}
+
+    //hash
+    inline size_t hash() const
     {
-      return (blockid <other.blockid)
-          || (blockid ==other.blockid && time<other.time)
-          || (blockid ==other.blockid && time==other.time && fieldname<other.fieldname);
+      size_t ret = std::hash<BigInt>()(blockid);
+      ret ^= std::hash<double>()(time) + 0x9e3779b9 + (ret << 6) + (ret >> 2);
+      ret ^= std::hash<String>()(fieldname) + 0x9e3779b9 + (ret << 6) + (ret >> 2);
+      return ret;
     }
 
-    //valid
-    inline bool valid() 
-    {return blockid >=0 && !fieldname.empty();}
+    //Hash
+    struct Hash {
+      inline size_t operator()(const Key& key) const {
+        return key.hash();
+      }
+    };
 
   };
 
@@ -81,118 +98,415 @@ public:
   class Cached
   {
   public:
-    Field                        field;
-    double                       time=0;
-    BigInt                       blockid =0;
+    Key                          key;
+    int                          level = 0;
     Array                        buffer;
+
+    //used by policies
     Cached                       *prev=nullptr,*next=nullptr;
+    int                          queue = 0;
+    bool                         referenced = false;
 
-    inline Key key() {
-      return Key(field.name,time, blockid);
+    //constructor
+    Cached(const Key& key_, int level_) : key(key_), level(level_) {
     }
   };
 
-  CriticalSection        lock;
-  Int64                  available=0,used=0;
-  Cached                 *front=nullptr,*back=nullptr;
-  std::map<Key,Cached*>  index;
+  //________________________________________________________________
+  class List
+  {
+  public:
 
-  //constructor
-  Shared(Int64 available_) : available(available_) {  
-  }
+    Cached *front = nullptr, *back = nullptr;
+    Int64  used = 0;
 
-  //destructor
-  ~Shared() {
-    while (!index.empty()) 
-      delete remove(back);
+    //empty
+    bool empty() const {
+      return front == nullptr;
+    }
 
-    VisusAssert(used==0);
-  }
+    //push_front
+    void push_front(Cached* cached)
+    {
+      VisusAssert(!cached->prev && !cached->next);
+      cached->next = this->front;
+      if (cached->next) cached->next->prev = cached; else this->back = cached;
+      this->front = cached;
+      this->used += cached->buffer.c_size();
+    }
 
-  //read
-  bool read(SharedPtr<BlockQuery> query) 
+    //remove
+    Cached* remove(Cached* cached)
+    {
+      VisusAssert((cached->prev || front == cached) && (cached->next || back == cached));
+      if (cached->prev) cached->prev->next = cached->next; else front = cached->next;
+      if (cached->next) cached->next->prev = cached->prev; else back = cached->prev;
+      cached->prev = cached->next = nullptr;
+      this->used -= cached->buffer.c_size();
+      return cached;
+    }
+
+    //moveToFront
+    void moveToFront(Cached* cached) {
+      if (cached != front)
+        push_front(remove(cached));
+    }
+
+  };
+
+  //________________________________________________________________
+  class Policy
   {
-    ScopedLock lock(this->lock);
+  public:
 
-    Key key(query->field.name, query->time, query->blockid);
-    auto it = index.find(key);
-    VisusAssert(it == index.end() || it->second->key() == key);
+    Int64 available = 0;
 
-    if (it == index.end())
-      return false;
+    //destructor
+    virtual ~Policy() {
+    }
 
-    query->buffer = it->second->buffer.clone();
+    //insert
+    virtual void insert(Cached* cached) = 0;
 
-    VisusAssert(query->field.name == it->second->field.name);
-    VisusAssert(query->time == it->second->time);
-    VisusAssert(query->blockid == it->second->blockid);
+    //touch
+    virtual void touch(Cached* cached) = 0;
 
-    if (it->second != front)
-      push_front(remove(it->second));
+    //remove
+    virtual void remove(Cached* cached) = 0;
 
-    //TODO: statistics without lock?
-    return true;
-  }
+    //victim (the policy must not remove it, it will be removed by the shard)
+    virtual Cached* victim() = 0;
+  };
 
-  //write
-  bool write(SharedPtr<BlockQuery> query) 
+  //________________________________________________________________
+  class LRUPolicy : public Policy
   {
-    ScopedLock lock(this->lock);
+  public:
 
-    Key key(query->field.name, query->time, query->blockid);
-    auto it = index.find(key);
-    VisusAssert(it == index.end() || it->second->key() == key);
+    List lru;
+
+    virtual void    insert(Cached* cached) override { lru.push_front(cached); }
+    virtual void    touch(Cached* cached) override { lru.moveToFront(cached); }
+    virtual void    remove(Cached* cached) override { lru.remove(cached); }
+    virtual Cached* victim() override { return lru.back; }
+  };
+
+  //________________________________________________________________
+  //second chance: hits only set a bit (i.e. no list manipulation on hits)
+  class ClockPolicy : public Policy
+  {
+  public:
+
+    List    ring;
+    Cached* hand = nullptr;
+
+    virtual void insert(Cached* cached) override {
+      cached->referenced = false;
+      ring.push_front(cached);
+    }
+
+    virtual void touch(Cached* cached) override {
+      cached->referenced = true;
+    }
 
-    Cached* cached = (it == index.end()) ? 0 : it->second;
-    if (!cached)
+    virtual void remove(Cached* cached) override {
+      if (hand == cached) hand = advance(hand);
+      ring.remove(cached);
+      if (hand == cached) hand = nullptr;
+    }
+
+    virtual Cached* victim() override
     {
-      while (available>0 && used >= available) 
-        delete remove(back);
-      cached = new Cached();
+      if (!hand) hand = ring.back;
+      while (hand && hand->referenced)
+      {
+        hand->referenced = false;
+        hand = advance(hand);
+      }
+      return hand;
+    }
+
+  private:
+
+    Cached* advance(Cached* cached) {
+      return cached->prev ? cached->prev : ring.back;
     }
+  };
 
-    cached->buffer = query->buffer.clone();
-    cached->field = query->field;
-    cached->time = query->time;
-    cached->blockid = query->blockid;
+  //________________________________________________________________
+  //2Q: new blocks enter a FIFO, blocks are promoted to the LRU only if they are requested again after being evicted from the FIFO 
+  //(so one-time scans of fine levels cannot flush the working set)
+  class TwoQueuePolicy : public Policy
+  {
+  public:
 
-    if (it == index.end())
-      push_front(cached);
+    enum { A1in = 1, Am = 2 };
 
-    else if (cached != front)
-      push_front(remove(cached));
+    List                                         a1in, am;
+    std::deque<Key>                              a1out;
+    std::unordered_set<Key, Key::Hash>           a1out_index;
+    size_t                                       num_cached = 0;
 
-    //TODO: statistics without lock?
-    return true;
+    virtual void insert(Cached* cached) override
+    {
+      auto it = a1out_index.find(cached->key);
+      if (it != a1out_index.end())
+      {
+        a1out_index.erase(it);
+        cached->queue = Am;
+        am.push_front(cached);
+      }
+      else
+      {
+        cached->queue = A1in;
+        a1in.push_front(cached);
+      }
+      num_cached++;
+    }
+
+    virtual void touch(Cached* cached) override {
+      if (cached->queue == Am)
+        am.moveToFront(cached);
+    }
+
+    virtual void remove(Cached* cached) override {
+      (cached->queue == Am ? am : a1in).remove(cached);
+      num_cached--;
+    }
+
+    virtual Cached* victim() override
+    {
+      //a1in is 25% of the memory
+      if (!a1in.empty() && (am.empty() || a1in.used > available / 4))
+      {
+        auto ret = a1in.back;
+        remember(ret->key);
+        return ret;
+      }
+      return am.back;
+    }
+
+  private:
+
+    //remember (ghost entries are only keys, keep as many as the cached blocks)
+    void remember(const Key& key)
+    {
+      if (!a1out_index.insert(key).second)
+        return;
+      a1out.push_back(key);
+      while (a1out.size() > std::max((size_t)64, num_cached))
+      {
+        a1out_index.erase(a1out.front());
+        a1out.pop_front();
+      }
+    }
+  };
+
+  //________________________________________________________________
+  //segmented LRU where blocks of coarse levels (which progressive queries read again and again) are evicted only 
+  //when they take more than half of the memory
+  class LevelAwarePolicy : public Policy
+  {
+  public:
+
+    enum { Probation = 1, Protected = 2 };
+
+    int  protected_level = 0;
+    List probation, protect;
+
+    //constructor
+    LevelAwarePolicy(int protected_level_) : protected_level(protected_level_) {
+    }
+
+    virtual void insert(Cached* cached) override {
+      cached->queue = cached->level <= protected_level ? Protected : Probation;
+      (cached->queue == Protected ? protect : probation).push_front(cached);
+    }
+
+    virtual void touch(Cached* cached) override {
+      (cached->queue == Protected ? protect : probation).moveToFront(cached);
+    }
+
+    virtual void remove(Cached* cached) override {
+      (cached->queue == Protected ? protect : probation).remove(cached);
+    }
+
+    virtual Cached* victim() override
+    {
+      if (!protect.empty() && (probation.empty() || protect.used > available / 2))
+        return protect.back;
+      return probation.back;
+    }
+  };
+
+  //________________________________________________________________
+  class Stats
+  {
+  public:
+    std::atomic<Int64> hits[MaxLevels], misses[MaxLevels], evictions[MaxLevels], used[MaxLevels];
+
+    //constructor
+    Stats() {
+      for (int I = 0; I < MaxLevels; I++)
+        hits[I] = misses[I] = evictions[I] = used[I] = 0;
+    }
+  };
+
+  //________________________________________________________________
+  class Shard
+  {
+  public:
+
+    CriticalSection                                 lock;
+    Int64                                           available = 0, used = 0;
+    UniquePtr<Policy>                               policy;
+    std::unordered_map<Key, Cached*, Key::Hash>     index;
+    Stats*                                          stats = nullptr;
+
+    //destructor
+    ~Shard() {
+      while (!index.empty())
+        delete remove(index.begin()->second, /*bEvicted*/false);
+      VisusAssert(used == 0);
+    }
+
+    //read
+    bool read(const Key& key, int level, Array& buffer)
+    {
+      ScopedLock lock(this->lock);
+
+      auto it = index.find(key);
+      if (it == index.end())
+      {
+        ++stats->misses[level];
+        return false;
+      }
+
+      Cached* cached = it->second;
+      VisusAssert(cached->key == key);
+      buffer = cached->buffer;
+      policy->touch(cached);
+      ++stats->hits[level];
+      return true;
+    }
+
+    //write
+    void write(const Key& key, int level, Array buffer)
+    {
+      ScopedLock lock(this->lock);
+
+      auto it = index.find(key);
+      if (it != index.end())
+        delete remove(it->second, /*bEvicted*/false);
+
+      //make room
+      while (available > 0 && !index.empty() && used + buffer.c_size() > available)
+      {
+        auto victim = policy->victim();
+        VisusReleaseAssert(victim);
+        delete remove(victim, /*bEvicted*/true);
+      }
+
+      auto cached = new Cached(key, level);
+      cached->buffer = buffer;
+      index[key] = cached;
+      used += cached->buffer.c_size();
+      stats->used[level] += cached->buffer.c_size();
+      policy->insert(cached);
+    }
+
+  private:
+
+    //remove
+    Cached* remove(Cached* cached, bool bEvicted)
+    {
+      VisusAssert(cached->key.valid());
+      policy->remove(cached);
+      index.erase(cached->key);
+      used -= cached->buffer.c_size();
+      stats->used[cached->level] -= cached->buffer.c_size();
+      if (bEvicted) ++stats->evictions[cached->level];
+      return cached;
+    }
+
+  };
+
+  Int64                                 available = 0;
+  int                                   bitsperblock = 0;
+  String                                policy;
+  Stats                                 stats; //must outlive shards (~Shard updates it)
+  std::vector< UniquePtr<Shard> >       shards;
+
+  //constructor
+  Shared(Int64 available_, int nshards, String policy_, int bitsperblock_) : available(available_), bitsperblock(bitsperblock_), policy(policy_)
+  {
+    nshards = std::max(1, nshards);
+    for (int I = 0; I < nshards; I++)
+    {
+      auto shard = new Shard();
+      shard->available = available > 0 ? std::max((Int64)1, available / nshards) : 0;
+      shard->stats = &stats;
+      shard->policy.reset(createPolicy(policy));
+      shard->policy->available = shard->available;
+      shards.push_back(UniquePtr<Shard>(shard));
+    }
+  }
+
+  //createPolicy
+  Policy* createPolicy(String name)
+  {
+    if (name.empty() || name == "lru")
+      return new LRUPolicy();
+
+    if (name == "clock")
+      return new ClockPolicy();
+
+    if (name == "2q" || name == "arc")
+      return new TwoQueuePolicy();
+
+    //protect block 0 and the first ProtectedLevels levels after it 
+    if (name == "level" || name == "level-aware")
+      return new LevelAwarePolicy(bitsperblock + ProtectedLevels);
+
+    ThrowException("unknown RamAccess policy", name);
+    return nullptr;
+  }
+
+  //getLevel (hz level of the first sample of the block; block 0 contains all levels up to bitsperblock)
+  int getLevel(BigInt blockid) const
+  {
+    int ret = bitsperblock;
+    for (; blockid > 0 && ret < MaxLevels - 1; blockid >>= 1)
+      ret++;
+    return ret;
   }
 
-private:
+  //getShard
+  Shard& getShard(const Key& key) {
+    return *shards[key.hash() % shards.size()];
+  }
 
-  //push_front
-  void push_front(Cached* cached)
+  //read
+  bool read(SharedPtr<BlockQuery> query, bool bCopyOnWrite)
   {
-    VisusAssert(cached->key().valid());
-    VisusAssert(!cached->prev && !cached->next);
-    cached->prev=0;
-    cached->next=this->front;
-    if (cached->prev) cached->prev->next=cached; else this->front = cached;
-    if (cached->next) cached->next->prev=cached; else this->back  = cached;
-    VisusAssert((cached->prev || front==cached) && (cached->next || back==cached));
-    this->used+=cached->buffer.c_size();
-    index[cached->key()]=cached;
+    Key key(query->field.name, query->time, query->blockid);
+
+    Array buffer;
+    if (!getShard(key).read(key, getLevel(query->blockid), buffer))
+      return false;
+
+    //a writer is going to modify the buffer in place (see Dataset::executeBoxQuery read-merge-write)
+    query->buffer = bCopyOnWrite ? buffer.clone() : buffer;
+    return true;
   }
 
-  //remove
-  Cached* remove(Cached* cached)
-  {
-    VisusAssert(cached->key().valid());
-    VisusAssert((cached->prev || front==cached) && (cached->next || back==cached));
-    if (cached->prev) cached->prev->next=cached->next; else front=cached->next;
-    if (cached->next) cached->next->prev=cached->prev; else back =cached->prev;
-    cached->prev=cached->next=0;
-    index.erase(cached->key());
-    this->used-=cached->buffer.c_size();
-    return cached;
+  //write
+  bool write(SharedPtr<BlockQuery> query) 
+  {
+    Key key(query->field.name, query->time, query->blockid);
+    auto buffer = query->buffer.clone(); //outside the shard lock
+    getShard(key).write(key, getLevel(query->blockid), buffer);
+    return true;
   }
 
 };
@@ -210,9 +524,9 @@ RamAccess::~RamAccess() {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void RamAccess::setAvailableMemory(Int64 value)
+void RamAccess::setAvailableMemory(Int64 value, int nshards, String policy)
 {
-  this->shared = std::make_shared<Shared>(value);
+  this->shared = std::make_shared<Shared>(value, nshards, policy, bitsperblock);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -224,7 +538,7 @@ void RamAccess::shareMemoryWith(SharedPtr<RamAccess> value)
 ////////////////////////////////////////////////////////////////////////////////
 void RamAccess::readBlock(SharedPtr<BlockQuery> query)  
 {
-  return shared->read(query)? readOk(query):readFailed(query,"not found");
+  return shared->read(query, /*bCopyOnWrite*/isWriting())? readOk(query):readFailed(query,"not found");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -233,18 +547,56 @@ void RamAccess::writeBlock(SharedPtr<BlockQuery> query)
   return shared->write(query)? writeOk(query):writeFailed(query,"not found");
 }
 
+////////////////////////////////////////////////////////////////////////////////
+RamAccessStatistics RamAccess::getCacheStatistics() const
+{
+  RamAccessStatistics ret;
+  ret.policy = shared->policy.empty() ? "lru" : shared->policy;
+  ret.available = shared->available;
+
+  for (int H = 0; H < Shared::MaxLevels; H++)
+  {
+    Int64 hits = shared->stats.hits[H], misses = shared->stats.misses[H], evictions = shared->stats.evictions[H], used = shared->stats.used[H];
+    if (!hits && !misses && !evictions && !used)
+      continue;
+
+    ret.hits += hits;
+    ret.misses += misses;
+    ret.evictions += evictions;
+    ret.used += used;
+
+    RamAccessStatistics::Level level;
+    level.H = H;
+    level.hits = hits;
+    level.misses = misses;
+    level.evictions = evictions;
+    level.used = used;
+    ret.levels.push_back(level);
+  }
+
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RamAccess::resetCacheStatistics()
+{
+  for (int H = 0; H < Shared::MaxLevels; H++)
+    shared->stats.hits[H] = shared->stats.misses[H] = shared->stats.evictions[H] = 0;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 void RamAccess::printStatistics()  {
   
   Access::printStatistics();
 
-  {
-    ScopedLock lock(shared->lock);
-    PrintInfo("RAM used", StringUtils::getStringFromByteSize(shared->used));
-    PrintInfo("RAM available", StringUtils::getStringFromByteSize(shared->available));
-  }
+  auto stats = getCacheStatistics();
+  PrintInfo("RAM policy", stats.policy, "shards", shared->shards.size());
+  PrintInfo("RAM used", StringUtils::getStringFromByteSize(stats.used));
+  PrintInfo("RAM available", StringUtils::getStringFromByteSize(stats.available));
+  PrintInfo("RAM hits", stats.hits, "misses", stats.misses, "evictions", stats.evictions);
+  for (auto level : stats.levels)
+    PrintInfo("  H", level.H, "hits", level.hits, "misses", level.misses, "evictions", level.evictions, "used", StringUtils::getStringFromByteSize(level.used));
 }
 
-} //namespace Visus 
+} //namespace Visus
 
@@ -45,12 +45,15 @@ For support : support@visus.net
 #include <Visus/Encoder.h>
 #include <Visus/Db.h>
 #include <Visus/Array.h>
+#include <Visus/ArrayUtils.h>
 #include <Visus/ModVisus.h>
 #include <Visus/Path.h>
 #include <Visus/ThreadPool.h>
 #include <Visus/NetService.h>
+#include <Visus/NetServer.h>
 #include <Visus/Utils.h>
 #include <Visus/IdxDiskAccess.h>
+#include <Visus/IdxStreamingImporter.h>
 #include <Visus/IdxMultipleDataset.h>
 #include <Visus/MultiplexAccess.h>
 #include <Visus/RamResource.h>
@@ -93,10 +96,74 @@ public:
       << "   [--bitsperblock <int>]" << std::endl
       << "   [--blocksperfile <int>]" << std::endl
       << "   [--filename_template <string>]" << std::endl
-      << "   [--time from to template]" << std::endl;
+      << "   [--time from to template]" << std::endl
+      << "   [--compression <string>]" << std::endl
+      << "   [--raw <filename> [--raw-offset <int>]]" << std::endl
+      << "   [--images <directory>]" << std::endl
+      << "   [--slab-size <bytes>]" << std::endl
+      << "   [--max-memory <bytes>]" << std::endl
+      << "Example: " << args[0] << " volume.idx --box \"0 2047 0 2047 0 4095\" --fields \"data float32\" --raw volume.raw --max-memory 8gb" << std::endl;
     return out.str();
   }
 
+  //importRaw (stream a row major raw file slab by slab)
+  static void importRaw(IdxStreamingImporter& importer, String filename, Int64 offset, Int64 slab_size)
+  {
+    File file;
+    if (!file.open(filename, "r"))
+      ThrowException("cannot open", filename);
+
+    auto field_dtype = importer.getField().dtype;
+    auto slice_size = field_dtype.getByteSize(importer.getSlabDims(1));
+    auto nslices = std::max((Int64)1, slab_size / slice_size);
+
+    importer.beginImport();
+    while (!importer.isComplete())
+    {
+      auto slab = Array(importer.getSlabDims(std::min(nslices, importer.getRemainingSlices())), field_dtype);
+      if (!file.read(offset, slab.c_size(), slab.c_ptr()))
+        ThrowException("cannot read", filename, "offset", offset);
+      offset += slab.c_size();
+      importer.importSlab(slab);
+    }
+    importer.endImport();
+  }
+
+  //importImages (stream an image stack, one image per slice, sorted by filename)
+  static void importImages(IdxStreamingImporter& importer, String directory, Int64 slab_size)
+  {
+    auto filenames = FileUtils::findFilesInDirectory(directory);
+    std::sort(filenames.begin(), filenames.end());
+
+    auto field_dtype = importer.getField().dtype;
+    auto slice_dims = importer.getSlabDims(1);
+    auto slice_size = field_dtype.getByteSize(slice_dims);
+    auto nslices = std::max((Int64)1, slab_size / slice_size);
+
+    //in case the stack is made of raw files
+    auto image_dims = slice_dims;
+    image_dims.setPointDim(slice_dims.getPointDim() - 1);
+    std::vector<String> load_args = { "--dtype", field_dtype.toString(), "--dims", image_dims.toString() };
+
+    if ((Int64)filenames.size() != importer.getRemainingSlices())
+      PrintWarning("found", filenames.size(), "images in", directory, "expecting", importer.getRemainingSlices());
+
+    importer.beginImport();
+    for (int I = 0; I < (int)filenames.size() && !importer.isComplete(); )
+    {
+      auto slab = Array(importer.getSlabDims(std::min(nslices, std::min(importer.getRemainingSlices(), (Int64)filenames.size() - I))), field_dtype);
+      for (Int64 Z = 0; Z < slab.dims[slab.dims.getPointDim() - 1]; Z++, I++)
+      {
+        auto image = ArrayUtils::loadImage(filenames[I], load_args);
+        if (!image.valid() || image.dtype != field_dtype || image.dims.innerProduct() != slice_dims.innerProduct())
+          ThrowException("wrong image", filenames[I], image.dims, image.dtype, "expecting", slice_dims, field_dtype);
+        memcpy(slab.c_ptr() + Z * slice_size, image.c_ptr(), slice_size);
+      }
+      importer.importSlab(slab);
+    }
+    importer.endImport();
+  }
+
   //exec
   virtual Array exec(Array data, std::vector<String> args) override
   {
@@ -105,6 +172,12 @@ public:
 
     String filename = args[1];
 
+    String compression = "zip";
+    String raw_filename, images_directory;
+    Int64 raw_offset = 0;
+    Int64 slab_size = 64 * 1024 * 1024;
+    Int64 max_memory = 0;
+
     IdxFile idxfile;
     if (data.valid() && data.getTotalNumberOfSamples())
     {
@@ -150,18 +223,56 @@ public:
 
         idxfile.time_template = time_template;
       }
+
+      else if (args[I] == "--compression")
+        compression = args[++I];
+
+      else if (args[I] == "--raw")
+        raw_filename = args[++I];
+
+      else if (args[I] == "--raw-offset")
+        raw_offset = StringUtils::getByteSizeFromString(args[++I]);
+
+      else if (args[I] == "--images")
+        images_directory = args[++I];
+
+      else if (args[I] == "--slab-size")
+        slab_size = StringUtils::getByteSizeFromString(args[++I]);
+
+      else if (args[I] == "--max-memory")
+        max_memory = StringUtils::getByteSizeFromString(args[++I]);
+
       else
       {
         //just ignore
       }
     }
 
+    //out-of-core: the input is never loaded as a whole
+    if (!raw_filename.empty() || !images_directory.empty())
+    {
+      for (auto& field : idxfile.fields)
+        field.default_compression = compression;
+      idxfile.save(filename);
+
+      auto db = LoadIdxDataset(filename);
+      IdxStreamingImporter importer(db.get(), db->getField(), db->getTime());
+      importer.max_memory = max_memory;
+
+      if (!raw_filename.empty())
+        importRaw(importer, raw_filename, raw_offset, slab_size);
+      else
+        importImages(importer, images_directory, slab_size);
+
+      return data;
+    }
+
     idxfile.save(filename);
 
     if (data.valid())
     {
       auto db = LoadIdxDataset(filename);
-      db->compressDataset({ "zip" }, data);
+      db->compressDataset({ compression }, data);
     }
 
     return data;
@@ -693,6 +804,530 @@ public:
   }
 };
 
+
+///////////////////////////////////////////////////////////
+class ServerLoadTest : public VisusConvert::Step
+{
+public:
+
+  //getHelp
+  virtual String getHelp(std::vector<String> args) override
+  {
+    std::ostringstream out;
+    out << args[0]
+      << " [--dataset <filename.idx>]" << std::endl
+      << " [--port <value>]" << std::endl
+      << " [--nthreads <compute-threads>]" << std::endl
+      << " [--nreactors <reactor-threads>]" << std::endl
+      << " [--nconnections <concurrent-clients>]" << std::endl
+      << " [--nrequests <requests-per-action>]" << std::endl
+      << " [--actions blockquery,boxquery]" << std::endl
+      << " [--compression zip]" << std::endl
+      << "Example: " << args[0] << " --nconnections 256 --nrequests 10000" << std::endl
+      << "Without --dataset a 256^3 uint8 zip-compressed dataset is created in tmp/server-load-test" << std::endl;
+    return out.str();
+  }
+
+  //exec
+  virtual Array exec(Array data, std::vector<String> args) override
+  {
+    String dataset_url = "";
+    int port = 10123;
+    int nthreads = 8;
+    int nreactors = 0;
+    int nconnections = 64;
+    int nrequests = 2000;
+    String actions = "blockquery,boxquery";
+    String compression = "zip";
+
+    for (int I = 1; I < (int)args.size(); I++)
+    {
+      if (args[I] == "--dataset")
+        dataset_url = args[++I];
+
+      else if (args[I] == "--port")
+        port = cint(args[++I]);
+
+      else if (args[I] == "--nthreads")
+        nthreads = cint(args[++I]);
+
+      else if (args[I] == "--nreactors")
+        nreactors = cint(args[++I]);
+
+      else if (args[I] == "--nconnections")
+        nconnections = cint(args[++I]);
+
+      else if (args[I] == "--nrequests")
+        nrequests = cint(args[++I]);
+
+      else if (args[I] == "--actions")
+        actions = args[++I];
+
+      else if (args[I] == "--compression")
+        compression = args[++I];
+
+      else
+        ThrowException(args[0], "Invalid arguments", args[I]);
+    }
+
+    if (dataset_url.empty())
+      dataset_url = createDataset("tmp/server-load-test/visus.idx");
+
+    auto db = LoadDataset(dataset_url);
+    VisusReleaseAssert(db);
+
+    auto modvisus = new ModVisus();
+    modvisus->configureDatasets(ConfigFile::fromString("<visus><dataset name='default' url='" + dataset_url + "' /></visus>"));
+
+    auto server = std::make_shared<NetServer>(port, modvisus, nthreads);
+    server->setNumberOfReactors(nreactors);
+    server->runInBackground();
+    Thread::sleep(500);
+
+    Url url("http://127.0.0.1:" + cstring(port) + "/mod_visus");
+    url.setParam("dataset", "default");
+    url.setParam("compression", compression);
+    url.setParam("field", db->getField().name);
+    url.setParam("time", cstring(db->getTime()));
+
+    for (auto action : StringUtils::split(actions, ","))
+    {
+      //precompute the requests, so that clients only measure the server
+      std::vector<Url> requests;
+      srand(0);
+      for (int I = 0; I < nrequests; I++)
+      {
+        Url request = url;
+        request.setParam("action", action);
+
+        if (action == "blockquery")
+        {
+          request.setParam("block", cstring(rand() % (int)std::min((BigInt)RAND_MAX, db->getTotalNumberOfBlocks())));
+        }
+        else if (action == "boxquery")
+        {
+          auto logic_box = db->getLogicBox();
+          auto box = logic_box;
+          for (int D = 0; D < box.getPointDim(); D++)
+          {
+            Int64 size = std::max((Int64)1, logic_box.size()[D] / 4);
+            box.p1[D] = logic_box.p1[D] + rand() % std::max((Int64)1, logic_box.size()[D] - size + 1);
+            box.p2[D] = box.p1[D] + size;
+          }
+          request.setParam("fromh", "0");
+          request.setParam("toh", cstring(db->getMaxResolution()));
+          request.setParam("maxh", cstring(db->getMaxResolution()));
+          request.setParam("box", box.toOldFormatString());
+        }
+        else
+        {
+          ThrowException(args[0], "unsupported action", action);
+        }
+
+        requests.push_back(request);
+      }
+
+      runClients(action, requests, nconnections);
+    }
+
+    server->signalExit();
+    server->waitForExit();
+    return Array();
+  }
+
+private:
+
+  //createDataset
+  String createDataset(String filename)
+  {
+    if (FileUtils::existsFile(Path(filename)))
+      return filename;
+
+    IdxFile idxfile;
+    idxfile.logic_box = BoxNi(PointNi(0, 0, 0), PointNi(256, 256, 256));
+    idxfile.fields = { Field("myfield", DTypes::UINT8) };
+    idxfile.fields[0].default_compression = "zip";
+    idxfile.save(filename);
+
+    auto db = LoadDataset(filename);
+    VisusReleaseAssert(db);
+
+    auto access = db->createAccess();
+    auto query = db->createBoxQuery(db->getLogicBox(), 'w');
+    db->beginBoxQuery(query);
+    VisusReleaseAssert(query->isRunning());
+
+    Array buffer(query->getNumberOfSamples(), query->field.dtype);
+    auto ptr = buffer.c_ptr();
+    for (Int64 I = 0, N = buffer.c_size(); I < N; I++)
+      ptr[I] = (Uint8)(I % 251);
+
+    query->buffer = buffer;
+    VisusReleaseAssert(db->executeBoxQuery(access, query));
+    return filename;
+  }
+
+  //runClients
+  void runClients(String action, const std::vector<Url>& requests, int nconnections)
+  {
+    std::atomic<int> next(0), nfailed(0);
+    std::vector< std::vector<double> > latencies(nconnections);
+
+    auto t1 = Time::now();
+
+    std::vector< SharedPtr<std::thread> > clients;
+    for (int C = 0; C < nconnections; C++)
+    {
+      clients.push_back(Thread::start("Load Test Client", [&, C]()
+      {
+        //persistent connection, reconnect only in case of errors
+        UniquePtr<NetSocket> socket;
+        for (int I = next++; I < (int)requests.size(); I = next++)
+        {
+          auto t2 = Time::now();
+
+          if (!socket)
+          {
+            socket.reset(new NetSocket());
+            if (!socket->connect(requests[I].toString()))
+            {
+              ++nfailed;
+              socket.reset();
+              continue;
+            }
+          }
+
+          NetResponse response;
+          if (socket->sendRequest(NetRequest(requests[I])))
+            response = socket->receiveResponse();
+
+          if (!response.isSuccessful())
+          {
+            ++nfailed;
+            socket.reset();
+            continue;
+          }
+
+          latencies[C].push_back(t2.elapsedMsec());
+        }
+      }));
+    }
+
+    for (auto client : clients)
+      Thread::join(client);
+
+    auto elapsed = t1.elapsedSec();
+
+    std::vector<double> all;
+    for (auto it : latencies)
+      all.insert(all.end(), it.begin(), it.end());
+    std::sort(all.begin(), all.end());
+
+    auto percentile = [&](double p) {
+      return all.empty() ? 0.0 : all[std::min(all.size() - 1, (size_t)(p * all.size()))];
+    };
+
+    PrintInfo("action", action,
+      "nconnections", nconnections,
+      "nrequests", requests.size(),
+      "nfailed", (int)nfailed,
+      "req/sec", elapsed > 0 ? (int)(all.size() / elapsed) : 0,
+      "p50(msec)", percentile(0.50),
+      "p99(msec)", percentile(0.99),
+      "max(msec)", all.empty() ? 0.0 : all.back());
+  }
+
+};
+
+///////////////////////////////////////////////////////////
+class ConvolveBenchmark : public VisusConvert::Step
+{
+public:
+
+  //getHelp
+  virtual String getHelp(std::vector<String> args) override
+  {
+    std::ostringstream out;
+    out << args[0]
+      << " [--dims <dims>]" << std::endl
+      << " [--dtype <dtype>]" << std::endl
+      << " [--kernel-sizes 3,9,31]" << std::endl
+      << " [--kernels gaussian,random]" << std::endl
+      << " [--methods direct,separable,fft]" << std::endl
+      << "Example: " << args[0] << " --dims \"256 256 64\" --kernel-sizes 5,15" << std::endl
+      << "The input data is used if available, otherwise a random volume is created" << std::endl;
+    return out.str();
+  }
+
+  //exec
+  virtual Array exec(Array data, std::vector<String> args) override
+  {
+    PointNi dims(256, 256, 64);
+    DType dtype = DTypes::FLOAT32;
+    String kernel_sizes = "3,9,31";
+    String kernels = "gaussian,random";
+    String methods = "direct,separable,fft";
+
+    for (int I = 1; I < (int)args.size(); I++)
+    {
+      if (args[I] == "--dims")
+        dims = PointNi::fromString(args[++I]);
+
+      else if (args[I] == "--dtype")
+        dtype = DType::fromString(args[++I]);
+
+      else if (args[I] == "--kernel-sizes")
+        kernel_sizes = args[++I];
+
+      else if (args[I] == "--kernels")
+        kernels = args[++I];
+
+      else if (args[I] == "--methods")
+        methods = args[++I];
+
+      else
+        ThrowException(args[0], "Invalid arguments", args[I]);
+    }
+
+    Array src = data;
+    if (!src.valid())
+    {
+      Array random(dims, DType(dtype.ncomponents(), DTypes::UINT8));
+      srand(0);
+      auto ptr = random.c_ptr();
+      for (Int64 I = 0, N = random.c_size(); I < N; I++)
+        ptr[I] = (Uint8)(rand() % 64);
+
+      src = ArrayUtils::cast(random, dtype);
+      if (!src.valid())
+        ThrowException(args[0], "cannot create source data");
+    }
+
+    int pdim = src.getPointDim();
+    PrintInfo("src dims", src.dims, "dtype", src.dtype);
+
+    for (auto kernel_size : StringUtils::split(kernel_sizes, ","))
+    {
+      int K = cint(kernel_size);
+      if (K <= 0 || (K % 2) == 0)
+        ThrowException(args[0], "kernel size must be odd", K);
+
+      PointNi kdims(pdim);
+      for (int D = 0; D < pdim; D++)
+        kdims[D] = src.dims[D] == 1 ? 1 : K;
+
+      for (auto kernel_type : StringUtils::split(kernels, ","))
+      {
+        Array kernel = createKernel(kdims, kernel_type);
+
+        Array reference;
+        for (auto method : StringUtils::split(methods, ","))
+        {
+          auto t1 = Time::now();
+          auto dst = ArrayUtils::convolve(src, kernel, method);
+          auto msec = t1.elapsedMsec();
+
+          if (!dst.valid())
+          {
+            PrintInfo("kernel", kdims, kernel_type, "method", method, "not applicable");
+            continue;
+          }
+
+          if (!reference.valid())
+            reference = dst;
+
+          PrintInfo("kernel", kdims, kernel_type, "method", method, "msec", msec, "max-diff", getMaxDiff(reference, dst));
+        }
+      }
+    }
+
+    return data;
+  }
+
+private:
+
+  //createKernel (normalized, gaussian ones are separable)
+  static Array createKernel(PointNi kdims, String type)
+  {
+    Array ret(kdims, DTypes::FLOAT64);
+    auto ptr = (Float64*)ret.c_ptr();
+    double sum = 0.0;
+    srand(0);
+    for (auto it = ForEachPoint(kdims); !it.end(); it.next())
+    {
+      double value = 1.0;
+      if (type == "gaussian")
+      {
+        for (int D = 0; D < kdims.getPointDim(); D++)
+        {
+          double sigma = std::max(1.0, kdims[D] / 6.0), x = (double)(it.pos[D] - kdims[D] / 2);
+          value *= exp(-(x * x) / (2 * sigma * sigma));
+        }
+      }
+      else if (type == "random")
+      {
+        value = rand() / (double)RAND_MAX;
+      }
+      else
+      {
+        ThrowException("unknown kernel type", type);
+      }
+      *ptr++ = value;
+      sum += value;
+    }
+
+    ptr = (Float64*)ret.c_ptr();
+    for (Int64 I = 0, N = ret.getTotalNumberOfSamples(); I < N; I++)
+      ptr[I] /= sum;
+
+    return ret;
+  }
+
+  //getMaxDiff
+  static double getMaxDiff(Array a, Array b)
+  {
+    auto A = (const Float64*)a.c_ptr();
+    auto B = (const Float64*)b.c_ptr();
+    double ret = 0.0;
+    for (Int64 I = 0, N = a.c_size() / sizeof(Float64); I < N; I++)
+      ret = std::max(ret, fabs(A[I] - B[I]));
+    return ret;
+  }
+
+};
+
+///////////////////////////////////////////////////////////
+class FilterBenchmark : public VisusConvert::Step
+{
+public:
+
+  //getHelp
+  virtual String getHelp(std::vector<String> args) override
+  {
+    std::ostringstream out;
+    out << args[0]
+      << " [--dims <dims>]" << std::endl
+      << " [--dtype <dtype>]" << std::endl
+      << " [--filter dehaar|min|max|identity]" << std::endl
+      << " [--window <window-size>]" << std::endl
+      << " [--dir <tmp-directory>]" << std::endl
+      << " [--methods sliding,tiles]" << std::endl
+      << "Example: " << args[0] << " --dims \"512 512 64\" --dtype float32 --filter dehaar" << std::endl
+      << "The input data is used if available, otherwise a random volume is created" << std::endl;
+    return out.str();
+  }
+
+  //exec
+  virtual Array exec(Array data, std::vector<String> args) override
+  {
+    PointNi dims(512, 512, 64);
+    DType dtype = DTypes::FLOAT32;
+    String filter_name = "dehaar";
+    int window_size = 128;
+    String dir = "tmp/filter-benchmark";
+    String methods = "sliding,tiles";
+
+    for (int I = 1; I < (int)args.size(); I++)
+    {
+      if (args[I] == "--dims")
+        dims = PointNi::fromString(args[++I]);
+
+      else if (args[I] == "--dtype")
+        dtype = DType::fromString(args[++I]);
+
+      else if (args[I] == "--filter")
+        filter_name = args[++I];
+
+      else if (args[I] == "--window")
+        window_size = cint(args[++I]);
+
+      else if (args[I] == "--dir")
+        dir = args[++I];
+
+      else if (args[I] == "--methods")
+        methods = args[++I];
+
+      else
+        ThrowException(args[0], "Invalid arguments", args[I]);
+    }
+
+    Array src = data;
+    if (!src.valid())
+    {
+      Array random(dims, DType(dtype.ncomponents(), DTypes::UINT8));
+      srand(0);
+      auto ptr = random.c_ptr();
+      for (Int64 I = 0, N = random.c_size(); I < N; I++)
+        ptr[I] = (Uint8)(rand() % 64);
+
+      src = ArrayUtils::cast(random, dtype);
+      if (!src.valid())
+        ThrowException(args[0], "cannot create source data");
+    }
+
+    int pdim = src.getPointDim();
+    PrintInfo("src dims", src.dims, "dtype", src.dtype, "filter", filter_name, "window", window_size);
+
+    Array reference;
+    for (auto method : StringUtils::split(methods, ","))
+    {
+      //blocks of a previous run would be reused (or overwritten only in part)
+      FileUtils::removeDirectory(Path(concatenate(dir, "/", method)));
+      String filename = concatenate(dir, "/", method, "/visus.idx");
+
+      IdxFile idxfile;
+      idxfile.logic_box = BoxNi(PointNi(pdim), src.dims);
+      Field field("data", src.dtype);
+      field.filter = filter_name;
+      idxfile.fields = { field };
+      idxfile.save(filename);
+
+      auto db = LoadIdxDataset(filename);
+      VisusReleaseAssert(db);
+      IdxStreamingImporter::importArray(db.get(), src);
+
+      field = db->getField();
+      auto filter = db->createFilter(field);
+      if (!filter)
+        ThrowException(args[0], "cannot create filter", filter_name, "for dtype", field.dtype);
+
+      auto t1 = Time::now();
+      if (method == "sliding")
+      {
+        auto access = db->createAccess();
+        db->computeFilter(filter, db->getTime(), field, access, PointNi::one(pdim) * window_size);
+      }
+      else if (method == "tiles")
+      {
+        Int64 max_tile_samples = 1;
+        for (int D = 0; D < pdim; D++)
+          max_tile_samples *= window_size;
+        db->computeFilterPyramid(filter, db->getTime(), field, max_tile_samples);
+      }
+      else
+      {
+        ThrowException(args[0], "unknown method", method);
+      }
+      auto msec = t1.elapsedMsec();
+
+      //read the filtered samples as they are stored
+      auto query = db->createBoxQuery(db->getLogicBox(), field, db->getTime(), 'r');
+      db->beginBoxQuery(query);
+      VisusReleaseAssert(query->isRunning());
+      VisusReleaseAssert(db->executeBoxQuery(db->createAccess(), query));
+
+      if (!reference.valid())
+        reference = query->buffer;
+
+      bool identical = reference.c_size() == query->buffer.c_size() && memcmp(reference.c_ptr(), query->buffer.c_ptr(), (size_t)reference.c_size()) == 0;
+      PrintInfo("method", method, "msec", msec, "identical", identical ? "yes" : "no");
+    }
+
+    return data;
+  }
+
+};
+
 } //namespace Private
 
 //////////////////////////////////////////////////////////////////////////////
@@ -714,6 +1349,9 @@ VisusConvert::VisusConvert()
   addAction("resample", []() {return std::make_shared<ResampleData>(); });
   addAction("get-component", []() {return std::make_shared<GetComponent>(); });
   addAction("idx-memory", []() {return std::make_shared<TestIdxMemory>(); });
+  addAction("server-load-test", []() {return std::make_shared<ServerLoadTest>(); });
+  addAction("convolve-benchmark", []() {return std::make_shared<ConvolveBenchmark>(); });
+  addAction("filter-benchmark", []() {return std::make_shared<FilterBenchmark>(); });
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -38,6 +38,8 @@ For support : support@visus.net
 
 #include <Visus/Encoder.h>
 #include <Visus/IdxDataset.h>
+#include <Visus/RamAccess.h>
+#include <Visus/IdxStreamingImporter.h>
 #include <Visus/File.h>
 
 namespace Visus {
@@ -122,6 +124,13 @@ static DType GetRandomDType()
   return DType(unsign, decimal, bitsize);
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+static String GetRandomCompression()
+{
+  static std::vector<String> v = { "", "lz4", "shuffle+lz4", "bitshuffle+zip", "delta+lz4" };
+  return v[Utils::getRandInteger(0, (int)v.size() - 1)];
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -286,6 +295,193 @@ protected:
 }; //end class 
 
 
+/////////////////////////////////////////////////////
+//drive every RamAccess policy with a small budget: a hot working set interleaved with a one-time scan of all the blocks 
+//(a miss is followed by a write, as a caching access in front of the disk would do)
+static void SelfTestRamAccess()
+{
+  IdxFile idxfile;
+  idxfile.logic_box = BoxNi(PointNi(0, 0), PointNi(256, 256));
+  idxfile.bitsperblock = 10;
+  idxfile.fields.push_back(Field("myfield", DTypes::UINT8));
+
+  auto filename = "tmp/self_test_ram/temp.idx";
+  idxfile.save(filename);
+  auto dataset = LoadIdxDataset(filename);
+  auto field = dataset->getField();
+  auto time = dataset->getTime();
+  int bitsperblock = dataset->getDefaultBitsPerBlock();
+  int nblocks = (int)dataset->getTotalNumberOfBlocks();
+  Int64 block_size = (Int64)1 << bitsperblock;
+  const int ncached = 8, nhot = 4;
+
+  //see RamAccess (level of the first sample of the block)
+  auto getLevel = [&](int blockid) {
+    int H = bitsperblock;
+    for (; blockid > 0; blockid >>= 1) H++;
+    return H;
+  };
+
+  for (auto policy : { "lru", "clock", "2q", "level" })
+  {
+    auto access = std::make_shared<RamAccess>(bitsperblock);
+    access->setAvailableMemory(ncached * block_size, /*nshards*/1, policy);
+
+    std::map<int, RamAccessStatistics::Level> expected;
+    Int64 nwrites = 0;
+
+    auto readBlock = [&](int blockid) 
+    {
+      access->beginRead();
+      auto query = dataset->createBlockQuery(blockid, field, time, 'r');
+      bool bOk = dataset->executeBlockQueryAndWait(access, query);
+      access->endRead();
+
+      auto& level = expected[getLevel(blockid)];
+      if (bOk)
+      {
+        level.hits++;
+        VisusReleaseAssert(query->buffer.c_size() == block_size);
+        for (Int64 I = 0; I < block_size; I++)
+          VisusReleaseAssert(query->buffer.c_ptr()[I] == (Uint8)blockid);
+        return true;
+      }
+
+      level.misses++;
+      access->beginWrite();
+      query = dataset->createBlockQuery(blockid, field, time, 'w');
+      query->buffer = Array(query->getNumberOfSamples(), field.dtype);
+      VisusReleaseAssert(query->buffer.c_size() == block_size);
+      memset(query->buffer.c_ptr(), (Uint8)blockid, (size_t)block_size);
+      VisusReleaseAssert(dataset->executeBlockQueryAndWait(access, query));
+      access->endWrite();
+      nwrites++;
+
+      //the writer owns its memory and can reuse it, the cache must not see the change
+      memset(query->buffer.c_ptr(), 0xff, (size_t)block_size);
+
+      auto stats = access->getCacheStatistics();
+      VisusReleaseAssert(stats.used <= stats.available);
+      return false;
+    };
+
+    //the scan blocks are read only once, the hot ones must survive it once the cache is warm (2q needs a few rounds to promote them)
+    int scan = nhot, hot_misses = 0, nrounds = (nblocks - nhot) / 2;
+    for (int round = 0; round < nrounds; round++)
+    {
+      for (int blockid = 0; blockid < nhot; blockid++)
+      {
+        bool bHit = readBlock(blockid);
+        if (!bHit && round >= nrounds / 2)
+          hot_misses++;
+      }
+      readBlock(scan++);
+      readBlock(scan++);
+    }
+
+    auto stats = access->getCacheStatistics();
+    PrintInfo("RamAccess policy", policy, "hits", stats.hits, "misses", stats.misses, "evictions", stats.evictions, "used", stats.used, "hot_misses", hot_misses);
+
+    VisusReleaseAssert(stats.policy == policy);
+    VisusReleaseAssert(stats.available == ncached * block_size);
+    VisusReleaseAssert(stats.used == ncached * block_size);
+    VisusReleaseAssert(stats.evictions == nwrites - ncached);
+    VisusReleaseAssert(hot_misses == 0);
+
+    //per-level statistics
+    Int64 hits = 0, misses = 0, evictions = 0, used = 0;
+    for (auto level : stats.levels)
+    {
+      auto it = expected.find(level.H);
+      VisusReleaseAssert(it != expected.end());
+      VisusReleaseAssert(level.hits == it->second.hits && level.misses == it->second.misses);
+      hits += level.hits; misses += level.misses; evictions += level.evictions; used += level.used;
+    }
+    VisusReleaseAssert(stats.levels.size() == expected.size());
+    VisusReleaseAssert(hits == stats.hits && misses == stats.misses && evictions == stats.evictions && used == stats.used);
+    VisusReleaseAssert(stats.misses == nwrites);
+
+    access->resetCacheStatistics();
+    stats = access->getCacheStatistics();
+    VisusReleaseAssert(stats.hits == 0 && stats.misses == 0 && stats.evictions == 0 && stats.used == ncached * block_size);
+  }
+
+  dataset.reset();
+  FileUtils::removeDirectory(Path("tmp/self_test_ram"));
+}
+
+
+/////////////////////////////////////////////////////
+//import with a tiny max_memory (so that partial blocks are spilled and reloaded many times) and slabs of random thickness,
+//then compare with the input and with an import that never spills
+static void SelfTestIdxStreamingImporter()
+{
+  for (auto compression : { "", "lz4" })
+  {
+    for (auto dims : { PointNi(37, 53, 29), PointNi(97, 61) })
+    {
+      int pdim = dims.getPointDim();
+      DType dtype = DTypes::UINT16;
+
+      Array data(dims, dtype);
+      for (Int64 I = 0, N = dims.innerProduct(); I < N; I++)
+        ((Uint16*)data.c_ptr())[I] = (Uint16)((I * 2654435761LL) >> 7);
+
+      auto slice_size = dtype.getByteSize(data.dims.innerProduct() / dims[pdim - 1]);
+
+      std::map<String, Int64> files[2];
+      for (int bSpill = 0; bSpill < 2; bSpill++)
+      {
+        String dir = concatenate("tmp/self_test_import/", bSpill ? "spill" : "nospill");
+        FileUtils::removeDirectory(Path(dir));
+
+        IdxFile idxfile;
+        idxfile.logic_box = BoxNi(PointNi(pdim), dims);
+        idxfile.bitsperblock = 8;
+        idxfile.blocksperfile = 16;
+        {
+          Field field("myfield", dtype);
+          field.default_compression = compression;
+          idxfile.fields.push_back(field);
+        }
+        idxfile.save(dir + "/temp.idx");
+        auto dataset = LoadIdxDataset(dir + "/temp.idx");
+
+        IdxStreamingImporter importer(dataset.get(), dataset->getField(), dataset->getTime());
+        importer.bVerbose = false;
+        importer.max_memory = bSpill ? 4 * dtype.getByteSize((Int64)1 << idxfile.bitsperblock) : 0;
+        importer.beginImport();
+        for (Int64 Z = 0; Z < dims[pdim - 1]; )
+        {
+          auto nslices = std::min((Int64)Utils::getRandInteger(1, 5), dims[pdim - 1] - Z);
+          auto slab_dims = importer.getSlabDims(nslices);
+          importer.importSlab(Array(slab_dims, dtype, HeapMemory::createUnmanaged(data.c_ptr() + Z * slice_size, dtype.getByteSize(slab_dims))));
+          Z += nslices;
+        }
+        importer.endImport();
+        VisusReleaseAssert(bSpill ? importer.getNumberOfSpilledBlocks() > 0 : importer.getNumberOfSpilledBlocks() == 0);
+
+        //bit for bit
+        auto query = dataset->createBoxQuery(dataset->getLogicBox(), 'r');
+        dataset->beginBoxQuery(query);
+        VisusReleaseAssert(dataset->executeBoxQuery(dataset->createAccess(), query));
+        VisusReleaseAssert(query->buffer.dims == dims && query->buffer.c_size() == data.c_size());
+        VisusReleaseAssert(memcmp(query->buffer.c_ptr(), data.c_ptr(), (size_t)data.c_size()) == 0);
+
+        //no scratch file left, and spilling must not leave anything in the dataset files
+        for (auto filename : FileUtils::findFilesInDirectory(dir))
+          VisusReleaseAssert(!StringUtils::contains(filename, ".~import"));
+        for (auto filename : FileUtils::findFilesInDirectory(dir + "/temp"))
+          files[bSpill][Path(filename).getFileName()] = FileUtils::getFileSize(filename);
+      }
+      VisusReleaseAssert(!files[0].empty() && files[0] == files[1]);
+    }
+  }
+
+  FileUtils::removeDirectory(Path("tmp/self_test_import"));
+}
+
+
 /////////////////////////////////////////////////////
 void SelfTestIdx(int max_seconds)
 {
@@ -318,6 +514,14 @@ void SelfTestIdx(int max_seconds)
   }
 #endif
 
+  PrintInfo("Running SelfTestRamAccess...");
+  SelfTestRamAccess();
+  PrintInfo("...done");
+
+  PrintInfo("Running SelfTestIdxStreamingImporter...");
+  SelfTestIdxStreamingImporter();
+  PrintInfo("...done");
+
   ////do self testing on random field
   PrintInfo("Running self test procedure max_seconds", max_seconds, "...");
 
@@ -337,7 +541,7 @@ void SelfTestIdx(int max_seconds)
           {
             Field field("myfield", DType(true, false, nbits));
             field.default_layout = layout;
-            field.default_compression = Utils::getRandInteger(0, 1) ? "lz4" : "";
+            field.default_compression = GetRandomCompression();
             idxfile.fields.push_back(field);
           }
 
@@ -372,7 +576,7 @@ void SelfTestIdx(int max_seconds)
       {
         Field field("myfield", DType(Utils::getRandInteger(1, 4), GetRandomDType()));
         field.default_layout = Utils::getRandInteger(0, 1) ? "" : "hzorder";
-        field.default_compression = Utils::getRandInteger(0, 1) ? "lz4" : "";
+        field.default_compression = GetRandomCompression();
         idxfile.fields.push_back(field);
       }
 
@@ -191,9 +191,15 @@ public:
   //very good explanation at http://www.cs.cornell.edu/courses/CS1114/2013sp/sections/S06_convolution.pdf
   //see http://www.johnloomis.org/ece563/notes/filter/conv/convolution.html
 
-  //convolve
+  //convolve (always "direct", use the method overload for the automatic choice)
   static Array convolve(Array src, Array kernel, Aborted aborted = Aborted());
 
+  //convolve (method can be "direct", "separable" or "fft", empty means guess the fastest one)
+  static Array convolve(Array src, Array kernel, String method, Aborted aborted = Aborted());
+
+  //convolveSeparable (one 1D kernel for each dimension of src, the kernel is their outer product)
+  static Array convolveSeparable(Array src, std::vector<Array> kernels, Aborted aborted = Aborted());
+
   //medianHybrid
   static Array medianHybrid(Array src, Array krn_size, Aborted aborted = Aborted());
 
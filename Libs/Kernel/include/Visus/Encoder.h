@@ -43,6 +43,9 @@ For support : support@visus.net
 #include <Visus/HeapMemory.h>
 #include <Visus/Point.h>
 #include <Visus/DType.h>
+#include <Visus/CriticalSection.h>
+
+#include <map>
 
 namespace Visus {
 
@@ -70,6 +73,11 @@ public:
   //decode
   virtual SharedPtr<HeapMemory> decode(PointNi dims,DType dtype, SharedPtr<HeapMemory> encoded)=0;
 
+  //trainDictionary (only for encoders supporting dictionaries, see Encoders::setDictionary)
+  virtual SharedPtr<HeapMemory> trainDictionary(DType dtype, std::vector< SharedPtr<HeapMemory> > samples, Int64 max_size) {
+    return SharedPtr<HeapMemory>();
+  }
+
 };
 
 
@@ -88,10 +96,19 @@ public:
   //getEncoder
   SharedPtr<Encoder> createEncoder(String specs) const;
 
+  //setDictionary (encoders find it by name in their specs, example "zstd-19-dict=<name>")
+  void setDictionary(String name, SharedPtr<HeapMemory> value);
+
+  //getDictionary
+  SharedPtr<HeapMemory> getDictionary(String name) const;
+
 private:
 
   std::vector< std::pair<String, Creator > > creators;
 
+  mutable CriticalSection                        dictionaries_lock;
+  std::map<String, SharedPtr<HeapMemory> >       dictionaries;
+
   //constructor
   Encoders() {}
 
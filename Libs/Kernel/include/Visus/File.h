@@ -96,6 +96,22 @@ public:
     MustCreateFile=0x01
   };
 
+  //__________________________________________________________________
+#if !SWIG
+  class VISUS_KERNEL_API ReadRequest
+  {
+  public:
+    Int64          pos = 0;
+    Int64          count = 0;
+    unsigned char* buffer = nullptr;
+    bool           ok = false;
+
+    //constructor
+    ReadRequest(Int64 pos_ = 0, Int64 count_ = 0, unsigned char* buffer_ = nullptr) : pos(pos_), count(count_), buffer(buffer_) {
+    }
+  };
+#endif
+
   //__________________________________________________________________
 #if !SWIG
   class VISUS_KERNEL_API Pimpl
@@ -139,6 +155,15 @@ public:
     //read (should be portable to 32 and 64 bit OS)
     virtual bool read(Int64 pos, Int64 count, unsigned char* buffer) = 0;
 
+    //read (multiple positional reads, by default executed one at a time)
+    virtual bool read(std::vector<ReadRequest>& requests) 
+    {
+      bool ret = true;
+      for (auto& it : requests)
+        ret = (it.ok = read(it.pos, it.count, it.buffer)) && ret;
+      return ret;
+    }
+
   protected:
 
     inline void onOpenEvent() {
@@ -225,6 +250,13 @@ public:
     return pimpl ? pimpl->read(pos, count, buffer) : false;
   }
 
+#if !SWIG
+  //read (multiple positional reads, on linux they can all be in flight at the same time using io_uring; returns true if all reads are ok)
+  bool read(std::vector<ReadRequest>& requests) {
+    return pimpl ? pimpl->read(requests) : false;
+  }
+#endif
+
 protected:
 
   UniquePtr<Pimpl> pimpl;
@@ -263,8 +295,10 @@ public:
   //getTimeLastAccessed
   static Int64 getTimeLastAccessed(Path path);
 
-  //special lock/unlock functions
-  static void lock  (Path path);
+  //lock (OS lock on `<path>.lock`, shared if !bExclusive; blocks until the lock is acquired or timeout_msec expires (<0 means wait forever))
+  static bool lock(Path path, bool bExclusive = true, Int64 timeout_msec = -1);
+
+  //unlock
   static void unlock(Path path);
 
   //touch
@@ -297,8 +331,8 @@ public:
   VISUS_NON_COPYABLE_CLASS(ScopedFileLock)
 
   //constructor
-  ScopedFileLock(String filename_) : filename(filename_) {
-    FileUtils::lock(filename);
+  ScopedFileLock(String filename_, bool bExclusive = true) : filename(filename_) {
+    FileUtils::lock(filename, bExclusive);
   }
 
   //destructor
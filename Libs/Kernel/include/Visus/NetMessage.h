@@ -222,6 +222,9 @@ public:
   //setArrayBody
   bool setArrayBody(String compression,Array value);
 
+  //setEncodedArrayBody (the body is already encoded with compression, for example a block as stored on disk)
+  void setEncodedArrayBody(String compression, PointNi dims, DType dtype, String layout, SharedPtr<HeapMemory> encoded);
+
   //getArrayBody
   Array getArrayBody() const {
     return ArrayUtils::decodeArray(this->headers, this->body);
@@ -327,6 +330,9 @@ public:
   //method DELETE,GET,HEAD,POST,PUT
   String method;
 
+  //protocol (i.e. HTTP/1.0 or HTTP/1.1, as sent by the client)
+  String protocol = "HTTP/1.1";
+
   struct
   {
   public:
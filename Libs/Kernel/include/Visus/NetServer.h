@@ -63,6 +63,8 @@ public:
   virtual NetResponse handleRequest(NetRequest request)=0;
 };
 
+class NetServerReactor;
+
 /////////////////////////////////////////////////////////////
 class VISUS_KERNEL_API NetServer 
 {
@@ -70,7 +72,7 @@ public:
 
   VISUS_NON_COPYABLE_CLASS(NetServer)
 
-  //constructor
+  //constructor (nthreads is the size of the compute pool executing the requests)
   NetServer(int port, NetServerModule* VISUS_DISOWN(module), int nthreads = 8);
 
   //destructor
@@ -84,6 +86,21 @@ public:
     this->verbose = value;
   }
 
+  //setKeepAliveTimeout (idle persistent connections are closed after this time, 0 disables keep-alive)
+  void setKeepAliveTimeout(int msec) {
+    this->keepalive_timeout_msec = msec;
+  }
+
+  //setNumberOfReactors (threads doing the non-blocking network I/O, 0 means automatic)
+  void setNumberOfReactors(int value) {
+    this->nreactors = value;
+  }
+
+  //setMaxClientBytes (in-flight bytes per client, when exceeded the server stops reading from the client)
+  void setMaxClientBytes(Int64 value) {
+    this->max_client_bytes = value;
+  }
+
   //runInThisThread
   void runInThisThread();
 
@@ -105,9 +122,20 @@ protected:
   UniquePtr<NetServerModule> module;
   SharedPtr<std::thread>     thread;
   bool                       bExitThread = false;
+  int                        keepalive_timeout_msec = 60000;
+  int                        nreactors = 0;
+  Int64                      max_client_bytes = 64 * 1024 * 1024;
+
+  friend class NetServerReactor;
+
+  //prepareResponse
+  void prepareResponse(NetResponse& response, bool bKeepAlive);
 
   //writeResponse
-  bool writeResponse(NetSocket* client, NetResponse response);
+  bool writeResponse(NetSocket* client, NetResponse response, bool bKeepAlive);
+
+  //handleConnection (serves the requests of a connection, returns true if the connection can be kept alive)
+  bool handleConnection(SharedPtr<NetSocket> client, bool bFirst);
 
 }; //end class
 
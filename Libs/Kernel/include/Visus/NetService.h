@@ -107,6 +107,9 @@ public:
   public:
     static String proxy;
     static int    proxy_port;
+    static bool   reuse_connections; //keep-alive connections pooled across NetService instances
+    static int    keepalive_timeout; //in seconds, idle pooled connections older than this are not reused
+    static int    dns_cache_timeout; //in seconds
   };
 
   //constructor
@@ -74,6 +74,15 @@ public:
   //close
   void close();
 
+  //getDescriptor (-1 if not open)
+  int getDescriptor() const;
+
+  //hasBufferedData (i.e. bytes already received but not consumed, for example pipelined requests)
+  bool hasBufferedData() const;
+
+  //setReceiveTimeout (a receive waiting longer than msec fails, 0 means wait forever)
+  void setReceiveTimeout(int msec);
+
   //connect (client side)
   bool connect(String url);
 
@@ -42,6 +42,9 @@ For support : support@visus.net
 #include <Visus/Path.h>
 #include <Visus/File.h>
 #include <Visus/TransferFunction.h>
+#include <Visus/ThreadPool.h>
+
+#include <complex>
 
 namespace Visus {
 
@@ -212,6 +215,7 @@ Array ArrayUtils::decodeArray(StringMap metadata, SharedPtr<HeapMemory> encoded)
     auto content_type = metadata.getValue("Content-Type");
     if      (content_type == "application/x-lz4")   compression = "lz4";
     else if (content_type == "application/zip")     compression = "zip";
+    else if (content_type == "application/zstd")    compression = "zstd";
     else if (content_type == "image/png")           compression = "png";
     else if (content_type == "image/jpeg")          compression = "jpg";
     else if (content_type == "image/tiff")          compression = "tif";
@@ -227,11 +231,216 @@ Array ArrayUtils::decodeArray(StringMap metadata, SharedPtr<HeapMemory> encoded)
 }
 
   
+//////////////////////////////////////////////////////////////////////////////////////////
+class ParallelFor
+{
+public:
+
+  //getNumberOfThreads
+  static int getNumberOfThreads()
+  {
+    static int ret = []() {
+      int value = std::max(1, (int)std::thread::hardware_concurrency());
+      if (auto env = getenv("VISUS_ARRAYUTILS_NTHREADS"))
+        value = std::max(1, cint(String(env)));
+      return value;
+    }();
+    return ret;
+  }
+
+  //run (split [0,tot) in chunks of at least 'grain' items, aborted is checked once per chunk, returns false if aborted)
+  static bool run(Int64 tot, Int64 grain, Aborted aborted, std::function<void(Int64, Int64)> fn)
+  {
+    grain = std::max((Int64)1, grain);
+
+    int   nthreads = getNumberOfThreads();
+    Int64 nchunks  = std::min((Int64)nthreads * 4, (tot + grain - 1) / grain);
+
+    //serial (also for nested calls, a worker must not wait for other workers)
+    if (nthreads <= 1 || nchunks <= 1 || bInsideWorker())
+    {
+      for (Int64 A = 0; A < tot; A += grain)
+      {
+        if (aborted()) return false;
+        fn(A, std::min(tot, A + grain));
+      }
+      return !aborted();
+    }
+
+    Semaphore done;
+    for (Int64 I = 0; I < nchunks; I++)
+    {
+      Int64 A = (tot * (I + 0)) / nchunks;
+      Int64 B = (tot * (I + 1)) / nchunks;
+      ThreadPool::push(getThreadPool(), [&fn, &done, aborted, A, B]() {
+        bInsideWorker() = true;
+        if (!aborted()) fn(A, B);
+        bInsideWorker() = false;
+        done.up();
+      });
+    }
+
+    for (Int64 I = 0; I < nchunks; I++)
+      done.down();
+
+    return !aborted();
+  }
+
+private:
+
+  //getThreadPool (NOTE: never destroyed, idle workers are just waiting for jobs)
+  static SharedPtr<ThreadPool> getThreadPool() {
+    static auto ret = new SharedPtr<ThreadPool>(std::make_shared<ThreadPool>("ArrayUtils Worker", getNumberOfThreads()));
+    return *ret;
+  }
+
+  //bInsideWorker
+  static bool& bInsideWorker() {
+    static thread_local bool ret = false;
+    return ret;
+  }
+
+};
+
+//TransformSamples (the loop is simple enough to be vectorized by the compiler)
+template <typename Dtype, typename Stype, class Function>
+static bool TransformSamples(Dtype* dst, const Stype* src, Int64 tot, Aborted aborted, Function fn)
+{
+  return ParallelFor::run(tot, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+    for (Int64 I = A; I < B; I++)
+      dst[I] = fn(src[I]);
+  });
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 class InsertArraySamples 
 {
 public:
 
+  //copyRow (the common cases get a loop with constant strides, so that the compiler can vectorize it)
+  template <class Sample>
+  static inline void copyRow(Sample* W, Int64 wstep, const Sample* R, Int64 rstep, Int64 num)
+  {
+    if (wstep == 1 && rstep == 1)
+    {
+      memcpy(W, R, sizeof(Sample) * num);
+    }
+    else if (wstep == 2 && rstep == 1)
+    {
+      for (Int64 I = 0; I < num; I++)
+        W[I << 1] = R[I];
+    }
+    else if (wstep == 1 && rstep == 2)
+    {
+      for (Int64 I = 0; I < num; I++)
+        W[I] = R[I << 1];
+    }
+    else
+    {
+      for (Int64 I = 0; I < num; I++, W += wstep, R += rstep)
+        *W = *R;
+    }
+  }
+
+  //_______________________________________________
+  template <class Sample, int D>
+  struct CopyRows
+  {
+    static inline void run(Sample* W, const Sample* R, const Int64* tot, const Int64* wdelta, const Int64* rdelta)
+    {
+      for (Int64 I = 0; I < tot[D]; I++, W += wdelta[D], R += rdelta[D])
+        CopyRows<Sample, D - 1>::run(W, R, tot, wdelta, rdelta);
+    }
+  };
+
+  //_______________________________________________
+  template <class Sample>
+  struct CopyRows<Sample, 0>
+  {
+    static inline void run(Sample* W, const Sample* R, const Int64* tot, const Int64* wdelta, const Int64* rdelta) {
+      copyRow(W, wdelta[0], R, rdelta[0], tot[0]);
+    }
+  };
+
+  //copySlab (copy [z1,z2) of the last dimension)
+  template <class Sample, int D>
+  static bool copySlab(Sample* W, const Sample* R, const Int64* tot, const Int64* wdelta, const Int64* rdelta, Int64 z1, Int64 z2, Aborted aborted)
+  {
+    W += z1 * wdelta[D];
+    R += z1 * rdelta[D];
+    for (Int64 I = z1; I < z2; I++, W += wdelta[D], R += rdelta[D])
+    {
+      if (aborted())
+        return false;
+      CopyRows<Sample, D - 1>::run(W, R, tot, wdelta, rdelta);
+    }
+    return true;
+  }
+
+  //copySlab
+  template <class Sample>
+  static bool copySlab(int N, Sample* W, const Sample* R, const Int64* tot, const Int64* wdelta, const Int64* rdelta, Int64 z1, Int64 z2, Aborted aborted)
+  {
+    switch (N)
+    {
+    case 1: copyRow(W + z1 * wdelta[0], wdelta[0], R + z1 * rdelta[0], rdelta[0], z2 - z1); return true;
+    case 2: return copySlab<Sample, 1>(W, R, tot, wdelta, rdelta, z1, z2, aborted);
+    case 3: return copySlab<Sample, 2>(W, R, tot, wdelta, rdelta, z1, z2, aborted);
+    case 4: return copySlab<Sample, 3>(W, R, tot, wdelta, rdelta, z1, z2, aborted);
+    case 5: return copySlab<Sample, 4>(W, R, tot, wdelta, rdelta, z1, z2, aborted);
+    default: VisusAssert(false); return false;
+    }
+  }
+
+  //executeWithPointers
+  template <class Sample>
+  bool executeWithPointers(Array& dst, Array src, int pdim, PointNi tot, PointNi wbegin, PointNi wdelta, PointNi rbegin, PointNi rdelta, PointNi ncontiguos, Aborted& aborted)
+  {
+    for (int D = 0; D < pdim; D++)
+    {
+      if (tot[D] <= 0)
+        return true;
+    }
+
+    auto W = (Sample*)dst.c_ptr();
+    auto R = (const Sample*)src.c_ptr();
+    for (int D = 0; D < pdim; D++)
+    {
+      W += wbegin[D];
+      R += rbegin[D];
+    }
+
+    //collapse the contiguous dimensions in a single row
+    Int64 Tot[5], Wdelta[5], Rdelta[5];
+    int N = 0, D = 0;
+    while (D + 1 < pdim && ncontiguos[D + 1]) D++;
+    if (ncontiguos[D])
+    {
+      Tot[0] = ncontiguos[D]; Wdelta[0] = 1; Rdelta[0] = 1;
+      N = 1; D++;
+    }
+    else
+    {
+      D = 0;
+    }
+    for (; D < pdim; D++, N++)
+    {
+      Tot[N] = tot[D]; Wdelta[N] = wdelta[D]; Rdelta[N] = rdelta[D];
+    }
+
+    //split the last dimension in slabs for big buffers
+    Int64 nbytes = sizeof(Sample); 
+    for (int I = 0; I < N; I++) 
+      nbytes *= Tot[I];
+
+    if (nbytes < 8 * 1024 * 1024)
+      return copySlab(N, W, R, Tot, Wdelta, Rdelta, 0, Tot[N - 1], aborted);
+
+    return ParallelFor::run(Tot[N - 1], 1, aborted, [&](Int64 z1, Int64 z2) {
+      copySlab(N, W, R, Tot, Wdelta, Rdelta, z1, z2, aborted);
+    });
+  }
+
   template <class Sample>
   bool execute(
     Array& dst, PointNi wfrom, PointNi wto, PointNi wstep,
@@ -317,6 +526,10 @@ public:
       }
     }
 
+    //fast path (bit aligned samples cannot be addressed with a pointer)
+    if (!std::is_same<Sample, BitAlignedSample>::value && pdim <= 5)
+      return executeWithPointers<Sample>(dst, src, pdim, tot, wbegin, wdelta, rbegin, rdelta, ncontiguos, aborted);
+
     PointNi p(pdim);
     PointNi woffset(pdim);
     PointNi roffset(pdim);
@@ -574,18 +787,15 @@ struct ConvertToSameDTypeOp
     int ncomponents = std::min(m, n);
     Int64 totsamples = src.getTotalNumberOfSamples();
 
-    //for each component...
-    for (int C = 0; C < ncomponents; C++)
-    {
-      Type* src_p = ((Type*)src.c_ptr()) + C;
-      Type* dst_p = ((Type*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
+    auto src_p = (const Type*)src.c_ptr();
+    auto dst_p = (Type*)dst.c_ptr();
+    return ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+      for (Int64 I = A; I < B; I++)
       {
-        if (aborted()) return false;
-        *dst_p = *src_p;
+        for (int C = 0; C < ncomponents; C++)
+          dst_p[I * m + C] = src_p[I * n + C];
       }
-    }
-    return true;
+    });
   }
 };
 
@@ -626,29 +836,18 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
     for (int C = 0; C < ncomponents; C++)
     {
       //compute the range
-      Uint16 min, max;
-      {
-        Uint16* src_p = ((Uint16*)src.c_ptr()) + C;
-        min = *src_p;
-        max = *src_p;
-        for (Int64 I = 0; I < totsamples; I++, src_p += n)
-        {
-          if (aborted()) return Array();
-          min = std::min(min, *src_p);
-          max = std::max(max, *src_p);
-        }
-        //PrintInfo("Range for component C",C,"min",min,"max",max);
-      }
-
-      {
-        Uint16* src_p = ((Uint16*)src.c_ptr()) + C;
-        Uint8*  dst_p = ((Uint8*)dst.c_ptr()) + C;
-        for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-        {
-          if (aborted()) return Array();
-          *dst_p = (Uint8)(255.0*(*src_p - min) / (double)(max - min));
-        }
-      }
+      Range range = computeRange(src, C, aborted);
+      if (aborted()) return Array();
+      auto min = (Uint16)range.from;
+      auto max = (Uint16)range.to;
+
+      auto src_p = ((const Uint16*)src.c_ptr()) + C;
+      auto dst_p = ((Uint8*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = (Uint8)(255.0*(src_p[I * n] - min) / (double)(max - min));
+      }))
+        return Array();
     }
     return dst;
   }
@@ -658,13 +857,13 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
   {
     for (int C = 0; C < ncomponents; C++)
     {
-      Uint8*   src_p = ((Uint8*)src.c_ptr()) + C;
-      Float32* dst_p = ((Float32*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-      {
-        if (aborted()) return Array();
-        *dst_p = (*src_p) / 255.0f;
-      }
+      auto src_p = ((const Uint8*)src.c_ptr()) + C;
+      auto dst_p = ((Float32*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = (src_p[I * n]) / 255.0f;
+      }))
+        return Array();
     }
     return dst;
   }
@@ -674,13 +873,13 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
   {
     for (int C = 0; C < ncomponents; C++)
     {
-      Uint8*   src_p = ((Uint8*)src.c_ptr()) + C;
-      Float64* dst_p = ((Float64*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-      {
-        if (aborted()) return Array();
-        *dst_p = (*src_p) / 255.0;
-      }
+      auto src_p = ((const Uint8*)src.c_ptr()) + C;
+      auto dst_p = ((Float64*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = (src_p[I * n]) / 255.0;
+      }))
+        return Array();
     }
     return dst;
   }
@@ -690,13 +889,13 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
   {
     for (int C = 0; C < ncomponents; C++)
     {
-      Float32* src_p = ((Float32*)src.c_ptr()) + C;
-      Float64* dst_p = ((Float64*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-      {
-        if (aborted()) return Array();
-        *dst_p = *src_p;
-      }
+      auto src_p = ((const Float32*)src.c_ptr()) + C;
+      auto dst_p = ((Float64*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = src_p[I * n];
+      }))
+        return Array();
     }
     return dst;
   }
@@ -707,14 +906,14 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
     for (int C = 0; C < ncomponents; C++)
     {
       Range range = src.dtype.getDTypeRange(C);
-      if (!range.delta()) range = computeRange(src,C);
-      Float32*  src_p = ((Float32*)src.c_ptr()) + C;
-      Uint8*    dst_p = ((Uint8*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-      {
-        if (aborted()) return Array();
-        *dst_p = (Uint8)(255 * Utils::clamp((Float32)((*src_p) - range.from) / (Float32)(range.to - range.from), 0.0f, 1.0f));
-      }
+      if (!range.delta()) range = computeRange(src,C,aborted);
+      auto src_p = ((const Float32*)src.c_ptr()) + C;
+      auto dst_p = ((Uint8*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = (Uint8)(255 * Utils::clamp((Float32)((src_p[I * n]) - range.from) / (Float32)(range.to - range.from), 0.0f, 1.0f));
+      }))
+        return Array();
     }
     return dst;
   }
@@ -725,14 +924,14 @@ Array ArrayUtils::smartCast(Array src, DType dtype_, Aborted aborted)
     for (int C = 0; C < ncomponents; C++)
     {
       Range range = src.dtype.getDTypeRange(C);
-      if (!range.delta()) range = computeRange(src,C);
-      Float64*  src_p = ((Float64*)src.c_ptr()) + C;
-      Uint8*    dst_p = ((Uint8*)dst.c_ptr()) + C;
-      for (Int64 I = 0; I < totsamples; I++, src_p += n, dst_p += m)
-      {
-        if (aborted()) return Array();
-        *dst_p = (Uint8)(255 * Utils::clamp((Float64)((*src_p) - range.from) / (Float64)(range.to - range.from), 0.0, 1.0));
-      }
+      if (!range.delta()) range = computeRange(src,C,aborted);
+      auto src_p = ((const Float64*)src.c_ptr()) + C;
+      auto dst_p = ((Uint8*)dst.c_ptr()) + C;
+      if (!ParallelFor::run(totsamples, 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 I = A; I < B; I++)
+          dst_p[I * m] = (Uint8)(255 * Utils::clamp((Float64)((src_p[I * n]) - range.from) / (Float64)(range.to - range.from), 0.0, 1.0));
+      }))
+        return Array();
     }
     return dst;
   }
@@ -786,12 +985,9 @@ static Array CastArray(Array src, DType dtype, Aborted& aborted)
   Dtype* dst_p = (Dtype*)dst.c_ptr();
   Stype* src_p = (Stype*)src.c_ptr();
   Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (Dtype)(src_p[I]);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [](Stype value) {
+    return (Dtype)value;
+  }) ? dst : Array();
 }
 
 template <typename Dtype>
@@ -849,12 +1045,9 @@ Array SqrtArray(Array src, Aborted& aborted)
   CppType* dst_p = (CppType*)dst.c_ptr();
   CppType* src_p = (CppType*)src.c_ptr();
   Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (CppType)sqrt(src_p[I]);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [](CppType value) {
+    return (CppType)sqrt(value);
+  }) ? dst : Array();
 }
 
 Array ArrayUtils::sqrt(Array src, Aborted aborted)
@@ -886,12 +1079,9 @@ Array AddArray(Array src, CppType value, Aborted& aborted)
   CppType* dst_p = (CppType*)dst.c_ptr();
   CppType* src_p = (CppType*)src.c_ptr();
   Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (CppType)(src_p[I] + value);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [value](CppType sample) {
+    return (CppType)(sample + value);
+  }) ? dst : Array();
 }
 
 Array ArrayUtils::add(Array src, double coeff, Aborted aborted)
@@ -922,12 +1112,9 @@ Array SubArrayAndValue(Array a, CppType b, Aborted& aborted)
   CppType* dst_p = (CppType*)dst.c_ptr();
   CppType* src_p = (CppType*)a.c_ptr();
   Int64 tot = a.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (CppType)(src_p[I] - b);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [b](CppType value) {
+    return (CppType)(value - b);
+  }) ? dst : Array();
 }
 
 Array ArrayUtils::sub(Array src, double coeff, Aborted aborted)
@@ -958,14 +1145,10 @@ Array SubNumberAndArray(CppType num, Array src, Aborted& aborted)
 
   CppType* DST = (CppType*)dst.c_ptr();
   CppType* SRC = (CppType*)src.c_ptr();
-  for (Int64 I = 0, tot = src.getTotalNumberOfSamples()*ncomponents; I < tot; I++)
-  {
-    if (aborted()) 
-      return Array();
-
-    DST[I] = (CppType)(num - SRC[I]);
-  }
-  return dst;
+  Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
+  return TransformSamples(DST, SRC, tot, aborted, [num](CppType value) {
+    return (CppType)(num - value);
+  }) ? dst : Array();
 }
 
 
@@ -999,12 +1182,9 @@ Array MulArray(Array src, CppType coeff, Aborted& aborted)
   CppType* dst_p = (CppType*)dst.c_ptr();
   CppType* src_p = (CppType*)src.c_ptr();
   Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (CppType)(coeff*src_p[I]);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [coeff](CppType value) {
+    return (CppType)(coeff*value);
+  }) ? dst : Array();
 }
 
 Array ArrayUtils::mul(Array src, double coeff, Aborted aborted)
@@ -1037,12 +1217,9 @@ Array DivArray(CppType coeff, Array src, Aborted& aborted)
   CppType* dst_p = (CppType*)dst.c_ptr();
   CppType* src_p = (CppType*)src.c_ptr();
   Int64 tot = src.getTotalNumberOfSamples()*ncomponents;
-  for (Int64 I = 0; I < tot; I++)
-  {
-    if (aborted()) return Array();
-    dst_p[I] = (CppType)(coeff / src_p[I]);
-  }
-  return dst;
+  return TransformSamples(dst_p, src_p, tot, aborted, [coeff](CppType value) {
+    return (CppType)(coeff / value);
+  }) ? dst : Array();
 }
 
 Array ArrayUtils::div(double coeff, Array src, Aborted aborted)
@@ -1138,18 +1315,54 @@ struct ComputeSingleComponentRangeOp
     range.from = NumericLimits<double>::highest();
     range.to   = NumericLimits<double>::lowest();
 
-    auto samples=GetComponentSamples<CppType>(src,ncomponent);
+    auto samples = GetComponentSamples<CppType>(src, ncomponent);
+    const CppType* ptr = samples.ptr;
+    int stride = samples.stride;
 
-    for (int I = 0; I < tot; I++)
+    //each chunk works with the native type (no conversion to double in the inner loop)
+    CriticalSection lock;
+    bool bEmpty = true;
+    CppType m = NumericLimits<CppType>::highest(), M = NumericLimits<CppType>::lowest();
+    if (!ParallelFor::run(tot, 256 * 1024, aborted, [&](Int64 A, Int64 B)
     {
-      if (aborted()) 
-        return false;
-      
-      double value = (double)samples[I];
-      if (value < range.from) range.from = value;
-      if (value > range.to  ) range.to   = value;
-    }
+      CppType m_ = NumericLimits<CppType>::highest(), M_ = NumericLimits<CppType>::lowest();
+      bool bEmpty_ = true;
+      if (stride == 1)
+      {
+        for (Int64 I = A; I < B; I++)
+        {
+          m_ = ptr[I] < m_ ? ptr[I] : m_;
+          M_ = ptr[I] > M_ ? ptr[I] : M_;
+        }
+        bEmpty_ = m_ > M_;
+      }
+      else
+      {
+        for (Int64 I = A; I < B; I++)
+        {
+          auto value = ptr[I * stride];
+          m_ = value < m_ ? value : m_;
+          M_ = value > M_ ? value : M_;
+        }
+        bEmpty_ = m_ > M_;
+      }
+
+      if (bEmpty_) 
+        return;
+
+      ScopedLock lock_(lock);
+      bEmpty = false;
+      m = std::min(m, m_);
+      M = std::max(M, M_);
+    }))
+      return false;
 
+    //all NaN
+    if (bEmpty)
+      return true;
+
+    range.from = (double)m;
+    range.to   = (double)M;
     return true;
   }
 };
@@ -1194,19 +1407,18 @@ public:
       auto write=GetComponentSamples<Sample>(dst,C);
       auto read =GetComponentSamples<Sample>(src,C);
 
-      int offset=0;
-      for (auto P=ForEachPoint(src.dims);!P.end();P.next(), offset++)
-      {
-        if (aborted()) 
-          return Array();
-
-        double value = read[offset];
-        value = (value- m) / (M - m);
-        value = filter.transform(value);
-        value = Utils::clamp(value, 0.0, 1.0);
-        value = (m + (M - m)*value);
-        write[offset] = (Sample) value;
-      }
+      if (!ParallelFor::run(src.getTotalNumberOfSamples(), 64 * 1024, aborted, [&](Int64 A, Int64 B) {
+        for (Int64 offset = A; offset < B; offset++)
+        {
+          double value = read[offset];
+          value = (value - m) / (M - m);
+          value = filter.transform(value);
+          value = Utils::clamp(value, 0.0, 1.0);
+          value = (m + (M - m)*value);
+          write[offset] = (Sample)value;
+        }
+      }))
+        return Array();
     }
 
     return dst;
@@ -1426,56 +1638,59 @@ public:
     auto wstride = wdims.stride();
     auto rstride = rdims.stride();
 
-    int wfrom = 0;
+    Int64 wfrom = 0;
 
     if (pdim == 2)
     {
-      Int64 rfrom;
-      double py[3], px[3];
-      Int64 X, Y;
-
-      for (Y = 0; Y < wdims[1]; Y++)
+      //rows are independent
+      if (!ParallelFor::run(wdims[1], 16, aborted, [&](Int64 Y1, Int64 Y2)
       {
-        if (aborted())
-          return false;
-
-        py[0] = Ti[1] * Y + Ti[2];
-        py[1] = Ti[4] * Y + Ti[5];
-        py[2] = Ti[7] * Y + Ti[8];
+        Int64 rfrom, wfrom = Y1 * wdims[0];
+        double py[3], px[3];
+        Int64 X, Y;
 
-        for (X = 0; X < wdims[0]; X++, wfrom++)
+        for (Y = Y1; Y < Y2; Y++)
         {
-          px[0] = Ti[0] * X + py[0];
-          px[1] = Ti[3] * X + py[1];
-          px[2] = Ti[6] * X + py[2];
-
-          px[0] /= px[2];
-          px[1] /= px[2];
+          py[0] = Ti[1] * Y + Ti[2];
+          py[1] = Ti[4] * Y + Ti[5];
+          py[2] = Ti[7] * Y + Ti[8];
 
-          if (px[0] >= 0 && px[0] < rdims[0] && px[1] >= 0 && px[1] < rdims[1])
+          for (X = 0; X < wdims[0]; X++, wfrom++)
           {
-            rfrom = Int64(px[0]) * rstride[0] + Int64(px[1]) * rstride[1];
-            write      [wfrom] = read      [rfrom];
-            write_alpha[wfrom] = read_alpha[rfrom];
+            px[0] = Ti[0] * X + py[0];
+            px[1] = Ti[3] * X + py[1];
+            px[2] = Ti[6] * X + py[2];
+
+            px[0] /= px[2];
+            px[1] /= px[2];
+
+            if (px[0] >= 0 && px[0] < rdims[0] && px[1] >= 0 && px[1] < rdims[1])
+            {
+              rfrom = Int64(px[0]) * rstride[0] + Int64(px[1]) * rstride[1];
+              write      [wfrom] = read      [rfrom];
+              write_alpha[wfrom] = read_alpha[rfrom];
+            }
           }
         }
-      }
+      }))
+        return false;
     }
     else if (pdim == 3)
     {
-      double px[4], py[4], pz[4];
-      Int64 X,Y,Z,rfrom;
-      for (Z = 0; Z < wdims[2]; Z++)
+      //rows (Y,Z) are independent
+      if (!ParallelFor::run(wdims[1] * wdims[2], 16, aborted, [&](Int64 R1, Int64 R2)
       {
-        pz[0] = Ti[ 2] * Z + Ti[ 3];
-        pz[1] = Ti[ 6] * Z + Ti[ 7];
-        pz[2] = Ti[10] * Z + Ti[11];
-        pz[3] = Ti[14] * Z + Ti[15];
-
-        for (Y = 0; Y < wdims[1]; Y++)
+        double px[4], py[4], pz[4];
+        Int64 X,Y,Z,rfrom, wfrom = R1 * wdims[0];
+        for (Int64 R = R1; R < R2; R++)
         {
-          if (aborted())
-            return false;
+          Y = R % wdims[1];
+          Z = R / wdims[1];
+
+          pz[0] = Ti[ 2] * Z + Ti[ 3];
+          pz[1] = Ti[ 6] * Z + Ti[ 7];
+          pz[2] = Ti[10] * Z + Ti[11];
+          pz[3] = Ti[14] * Z + Ti[15];
 
           py[0] = Ti[ 1] * Y + pz[0];
           py[1] = Ti[ 5] * Y + pz[1];
@@ -1504,7 +1719,8 @@ public:
             }
           }
         }
-      }
+      }))
+        return false;
     }
     else
     {
@@ -2446,108 +2662,535 @@ Array ArrayUtils::executeOperation(Operation op,std::vector<Array> args,Aborted
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-struct ConvolveOp
+/*
+Convolution engine, works on one component at a time (Float64 samples, dimensions padded to 3D with 1).
+NOTE: it's a correlation (i.e. the kernel is not flipped) with clamping at the borders (the same as the original dense stencil)
+
+  - direct:    dense stencil, cost prod(K) per sample
+  - separable: 1D passes for kernels that are the outer product of 1D kernels, cost sum(K) per sample
+  - fft:       overlap-save on tiles of size T (power of 2), cost ~ log2(T) per sample (good for big kernels)
+
+All of them split the volume in independent pieces (rows, lines or tiles) executed by ParallelFor
+*/
+class Convolution
 {
-  template<typename SrcType>
-  bool execute(Array& dst,Array src,Array& kernel,Aborted aborted)
+public:
+
+  typedef std::complex<double> Complex;
+
+  Int64 S[3] = { 1,1,1 }; //source dims
+  Int64 K[3] = { 1,1,1 }; //kernel dims (odd)
+  Int64 C[3] = { 0,0,0 }; //kernel center
+
+  std::vector<double> kernel;               //dense kernel (empty when only the separable factors are known)
+  std::vector<double> factors[3];           //separable factors (empty if not separable)
+
+  //constructor
+  Convolution() {
+  }
+
+  //getTotalNumberOfSamples
+  Int64 getTotalNumberOfSamples() const {
+    return S[0] * S[1] * S[2];
+  }
+
+  //findSeparableFactors (K=f0 x f1 x f2, for a rank-1 kernel f_d is the line of K through the max value divided by the max value)
+  bool findSeparableFactors()
   {
-    //necessary conditions
-    if (!src.dtype.valid() ||
-        !kernel.getTotalNumberOfSamples() ||
-        !kernel.dtype.valid() ||
-        kernel.dtype.ncomponents()!=1)
-    {
-      VisusAssert(aborted());
+    if (kernel.empty())
       return false;
-    }
 
-    if (!dst.resize(src.dims,DType(src.dtype.ncomponents(),DTypes::FLOAT64),__FILE__,__LINE__))
+    Int64 pivot = 0;
+    for (Int64 I = 0; I < (Int64)kernel.size(); I++)
+      if (fabs(kernel[I]) > fabs(kernel[pivot])) pivot = I;
+
+    double max_value = kernel[pivot];
+    if (!max_value)
       return false;
 
-    dst.shareProperties(src);
+    Int64 P[3] = { pivot % K[0], (pivot / K[0]) % K[1], pivot / (K[0] * K[1]) };
+    std::vector<double> f[3];
+    for (int D = 0; D < 3; D++)
+    {
+      for (Int64 I = 0; I < K[D]; I++)
+      {
+        Int64 Q[3] = { P[0],P[1],P[2] }; Q[D] = I;
+        f[D].push_back(kernel[Q[0] + K[0] * (Q[1] + K[1] * Q[2])] / (D ? max_value : 1.0));
+      }
+    }
 
-    //I'm just interested in a "preview"
-    if (!src.getTotalNumberOfSamples())
-      return true;
+    const double tolerance = 1e-10 * fabs(max_value);
+    for (Int64 Z = 0, I = 0; Z < K[2]; Z++) for (Int64 Y = 0; Y < K[1]; Y++) for (Int64 X = 0; X < K[0]; X++, I++)
+    {
+      if (fabs(kernel[I] - f[0][X] * f[1][Y] * f[2][Z]) > tolerance)
+        return false;
+    }
 
-    int pdim = src.getPointDim();
+    for (int D = 0; D < 3; D++)
+      factors[D] = f[D];
+
+    return true;
+  }
+
+  //guessMethod
+  String guessMethod() const
+  {
+    if (!factors[0].empty())
+      return "separable";
+
+    double direct_cost = (double)(K[0] * K[1] * K[2]);
+
+    Int64 T[3], V[3]; getTileSize(T, V);
+    double ratio = 1.0, log2 = 0.0;
+    for (int D = 0; D < 3; D++)
+    {
+      ratio *= (double)T[D] / (double)V[D];
+      log2 += Utils::getLog2(T[D]);
+    }
+
+    //forward and inverse butterflies, plus the complex product
+    double fft_cost = ratio * (10.0 * log2 + 6.0);
+    return fft_cost < direct_cost ? "fft" : "direct";
+  }
+
+  //run
+  bool run(String method, const double* src, double* dst, Aborted aborted)
+  {
+    if (method == "separable") return runSeparable(src, dst, aborted);
+    if (method == "fft"      ) return runFFT      (src, dst, aborted);
+    return runDirect(src, dst, aborted);
+  }
+
+private:
+
+  //clamp
+  static inline Int64 clamp(Int64 value, Int64 N) {
+    return value < 0 ? 0 : (value >= N ? N - 1 : value);
+  }
 
-    //dimensions (ignore where dims==1 i.e. where memory layout does not change (for example src has dims (1,200,300,1,1)->(200,300))
-    PointNi Sdims=PointNi::one(pdim); int Sspace=0;
-    PointNi Kdims=PointNi::one(pdim); int Kspace=0;
-    for (int I=0;I<pdim;I++)
+  //runDirect
+  bool runDirect(const double* src, double* dst, Aborted aborted)
+  {
+    VisusReleaseAssert(!kernel.empty());
+    return ParallelFor::run(S[1] * S[2], std::max((Int64)1, (64 * 1024) / (S[0] * K[0] * K[1] * K[2])), aborted, [&](Int64 R1, Int64 R2)
     {
-      VisusAssert(src   .dims[I]>=1);
-      VisusAssert(kernel.dims[I]>=1);
+      for (Int64 R = R1; R < R2; R++)
+      {
+        Int64 Y = R % S[1], Z = R / S[1];
+        double* out = dst + R * S[0];
+        for (Int64 X = 0; X < S[0]; X++)
+        {
+          double sum = 0.0;
+          const double* kernel_p = &kernel[0];
+          for (Int64 KZ = 0; KZ < K[2]; KZ++)
+          {
+            Int64 ZZ = clamp(Z + KZ - C[2], S[2]);
+            for (Int64 KY = 0; KY < K[1]; KY++)
+            {
+              const double* row = src + (ZZ * S[1] + clamp(Y + KY - C[1], S[1])) * S[0];
+              if (X >= C[0] && X + K[0] - C[0] <= S[0])
+              {
+                const double* p = row + X - C[0];
+                for (Int64 KX = 0; KX < K[0]; KX++)
+                  sum += p[KX] * (*kernel_p++);
+              }
+              else
+              {
+                for (Int64 KX = 0; KX < K[0]; KX++)
+                  sum += row[clamp(X + KX - C[0], S[0])] * (*kernel_p++);
+              }
+            }
+          }
+          out[X] = sum;
+        }
+      }
+    });
+  }
+
+  //runSeparable
+  bool runSeparable(const double* src, double* dst, Aborted aborted)
+  {
+    VisusReleaseAssert(!factors[0].empty());
+
+    Int64 tot = getTotalNumberOfSamples();
+    std::vector<double> tmp(tot);
+    memcpy(dst, src, sizeof(double) * tot);
 
-      if (src.dims[I]==1 && kernel.dims[I]==1)
+    Int64 stride[3] = { 1, S[0], S[0] * S[1] };
+    for (int D = 0; D < 3; D++)
+    {
+      if (K[D] == 1 && factors[D][0] == 1.0)
         continue;
 
-      Sdims[Sspace++]=src   .dims[I];
-      Kdims[Kspace++]=kernel.dims[I];
+      //one 1D pass along D, dst->tmp->dst
+      memcpy(&tmp[0], dst, sizeof(double) * tot);
+      const double* in = &tmp[0];
+      const double* f = &factors[D][0];
+      Int64 N = S[D], L = K[D], c = C[D], nlines = tot / N;
+
+      if (!ParallelFor::run(nlines, std::max((Int64)1, (64 * 1024) / (N * L)), aborted, [&](Int64 A, Int64 B)
+      {
+        std::vector<double> line(N + L - 1);
+        for (Int64 I = A; I < B; I++)
+        {
+          //first sample of the line
+          Int64 lo = D == 0 ? 0 : I % stride[D];
+          Int64 first = (I / stride[D]) * stride[D] * N + lo;
+
+          for (Int64 J = 0; J < N + L - 1; J++)
+            line[J] = in[first + clamp(J - c, N) * stride[D]];
+
+          for (Int64 J = 0; J < N; J++)
+          {
+            double sum = 0.0;
+            for (Int64 k = 0; k < L; k++)
+              sum += line[J + k] * f[k];
+            dst[first + J * stride[D]] = sum;
+          }
+        }
+      }))
+        return false;
+    }
+
+    return true;
+  }
+
+  //getTileSize (overlap-save, each tile of size T produces V=T-K+1 valid samples)
+  void getTileSize(Int64 T[3], Int64 V[3]) const
+  {
+    for (int D = 0; D < 3; D++)
+    {
+      T[D] = K[D] == 1 ? 1 : std::min(Utils::getPowerOf2(std::max((Int64)16, 4 * (K[D] - 1))), Utils::getPowerOf2(S[D] + K[D] - 1));
+      V[D] = T[D] - (K[D] - 1);
     }
+  }
 
-    const PointNi Kcenter=Kdims.rightShift(1);
+  //FFTPlan
+  struct FFTPlan
+  {
+    Int64 N = 1;
+    std::vector<Int64>   reversed;
+    std::vector<Complex> twiddles;
 
-    if (!Kspace || !Sspace || Kspace>Sspace || ((Kcenter.leftShift(1))+PointNi::one(pdim))!=Kdims)
+    //constructor
+    FFTPlan(Int64 N_ = 1) : N(N_)
     {
-      VisusAssert(aborted());
-      return false;
+      int nbits = Utils::getLog2(N);
+      for (Int64 I = 0; I < N; I++)
+      {
+        Int64 R = 0;
+        for (int B = 0; B < nbits; B++)
+          if (I & ((Int64)1 << B)) R |= (Int64)1 << (nbits - 1 - B);
+        reversed.push_back(R);
+      }
+      for (Int64 I = 0; I < N / 2; I++)
+        twiddles.push_back(std::polar(1.0, -2.0 * Math::Pi * (double)I / (double)N));
     }
 
-    //what to do with (set|get)SingleComponentRange?
+    //execute (in place, iterative radix-2)
+    void execute(Complex* a, bool bInverse) const
+    {
+      for (Int64 I = 0; I < N; I++)
+        if (I < reversed[I]) std::swap(a[I], a[reversed[I]]);
 
-    //for each component...
-    int ncomponents=src.dtype.ncomponents();
-    for (int C=0;C<ncomponents;C++)
+      for (Int64 len = 2; len <= N; len <<= 1)
+      {
+        Int64 half = len >> 1, step = N / len;
+        for (Int64 I = 0; I < N; I += len)
+        {
+          for (Int64 J = 0; J < half; J++)
+          {
+            Complex w = bInverse ? std::conj(twiddles[J * step]) : twiddles[J * step];
+            Complex u = a[I + J], v = a[I + J + half] * w;
+            a[I + J] = u + v;
+            a[I + J + half] = u - v;
+          }
+        }
+      }
+    }
+  };
+
+  //fft3 (separable N-D transform on a T[0]*T[1]*T[2] tile)
+  static void fft3(Complex* tile, const Int64 T[3], const FFTPlan plan[3], bool bInverse, std::vector<Complex>& line)
+  {
+    Int64 stride[3] = { 1, T[0], T[0] * T[1] };
+    Int64 tot = T[0] * T[1] * T[2];
+    for (int D = 0; D < 3; D++)
     {
-      PointNi        stride=Sdims.stride()*ncomponents;
-      const SrcType* src_p=((SrcType*)src.c_ptr())+C;
-      Float64*       dst_p=((Float64*)dst.c_ptr())+C;
-      const Float64* kernel_begin=(Float64*)kernel.c_ptr();
+      if (T[D] == 1) continue;
+      line.resize(T[D]);
+      for (Int64 I = 0; I < tot / T[D]; I++)
+      {
+        Int64 lo = D == 0 ? 0 : I % stride[D];
+        Int64 first = (I / stride[D]) * stride[D] * T[D] + lo;
+        for (Int64 J = 0; J < T[D]; J++) line[J] = tile[first + J * stride[D]];
+        plan[D].execute(&line[0], bInverse);
+        for (Int64 J = 0; J < T[D]; J++) tile[first + J * stride[D]] = line[J];
+      }
+    }
+  }
 
-      PointNi to=Sdims;
+  //runFFT
+  bool runFFT(const double* src, double* dst, Aborted aborted)
+  {
+    //dense kernel from factors if needed
+    if (kernel.empty())
+    {
+      VisusReleaseAssert(!factors[0].empty());
+      for (Int64 Z = 0; Z < K[2]; Z++) for (Int64 Y = 0; Y < K[1]; Y++) for (Int64 X = 0; X < K[0]; X++)
+        kernel.push_back(factors[0][X] * factors[1][Y] * factors[2][Z]);
+    }
 
-      // this is a trick to let the inner most loop executing only once
-      to[0]=1; 
+    Int64 T[3], V[3]; getTileSize(T, V);
+    FFTPlan plan[3] = { FFTPlan(T[0]), FFTPlan(T[1]), FFTPlan(T[2]) };
+    Int64 Ttot = T[0] * T[1] * T[2];
+
+    //spectrum of the flipped kernel (correlation), normalized for the inverse transform
+    std::vector<Complex> H(Ttot), line;
+    for (Int64 Z = 0, I = 0; Z < K[2]; Z++) for (Int64 Y = 0; Y < K[1]; Y++) for (Int64 X = 0; X < K[0]; X++, I++)
+      H[(K[0] - 1 - X) + T[0] * ((K[1] - 1 - Y) + T[1] * (K[2] - 1 - Z))] = kernel[I] / (double)Ttot;
+    fft3(&H[0], T, plan, false, line);
 
-      const Int64 num_step_x=(Sdims[0])/1;
+    Int64 ntiles[3];
+    for (int D = 0; D < 3; D++)
+      ntiles[D] = (S[D] + V[D] - 1) / V[D];
 
-      for (auto P = ForEachPoint(to); !P.end(); P.next())
+    return ParallelFor::run(ntiles[0] * ntiles[1] * ntiles[2], 1, aborted, [&](Int64 A, Int64 B)
+    {
+      std::vector<Complex> tile(Ttot), line;
+      for (Int64 I = A; I < B; I++)
       {
-        // we take out the most inner loop for parallelization
-        for (Int64 i=0;i<Sdims[0];i++) 
+        Int64 P[3] = { (I % ntiles[0]) * V[0], ((I / ntiles[0]) % ntiles[1]) * V[1], (I / (ntiles[0] * ntiles[1])) * V[2] };
+
+        //tile input (clamped at the borders)
+        for (Int64 Z = 0, N = 0; Z < T[2]; Z++)
         {
-          // copy P so that different threads don't modify the same variable P
-          PointNi Q=P.pos; 
-          Q[0]=i;
-          Float64 sum=0.0;
-          const Float64* kernel_p=kernel_begin;
-          PointNi Sp(pdim), Kp(pdim), Tp(pdim);
-          //#define ForKernel(n) for (Kp[n]=0, Sp[n]=Q[n]-Kcenter[n]; Kp[n]<Kdims[n]; ++Kp[n], ++Sp[n]) { if (Sp[n]<0 || Sp[n]>=Sdims[n]) { int skip=1; int n1=n; while(n1-- != 0) skip *= Kdims[n1]; kernel_p += skip; continue; }
-          #define ForKernel(n) for (Kp[n]=0, Sp[n]=Q[n]-Kcenter[n]; Kp[n]<Kdims[n]; ++Kp[n], ++Sp[n]) { Tp[n] = Sp[n] < 0 ? 0 : Sp[n]>=Sdims[n] ? Sdims[n]-1 : Sp[n];
-          switch (Kspace)
+          Int64 ZZ = clamp(P[2] - C[2] + Z, S[2]);
+          for (Int64 Y = 0; Y < T[1]; Y++)
           {
-          case 1:                           ForKernel(0) sum+=(Float64)(src_p[Tp[0]*stride[0]                                ]) * (Float64)(*kernel_p++);}    break;
-          case 2:              ForKernel(1) ForKernel(0) sum+=(Float64)(src_p[Tp[0]*stride[0]+Tp[1]*stride[1]                ]) * (Float64)(*kernel_p++);}}   break;
-          case 3: ForKernel(2) ForKernel(1) ForKernel(0) sum+=(Float64)(src_p[Tp[0]*stride[0]+Tp[1]*stride[1]+Tp[2]*stride[2]]) * (Float64)(*kernel_p++);}}}  break;
-          default:VisusAssert(false);
+            const double* row = src + (ZZ * S[1] + clamp(P[1] - C[1] + Y, S[1])) * S[0];
+            for (Int64 X = 0; X < T[0]; X++, N++)
+              tile[N] = row[clamp(P[0] - C[0] + X, S[0])];
+          }
+        }
+
+        fft3(&tile[0], T, plan, false, line);
+        for (Int64 N = 0; N < Ttot; N++)
+          tile[N] *= H[N];
+        fft3(&tile[0], T, plan, true, line);
+
+        //valid output
+        for (Int64 Z = 0; Z < V[2] && P[2] + Z < S[2]; Z++)
+        {
+          for (Int64 Y = 0; Y < V[1] && P[1] + Y < S[1]; Y++)
+          {
+            const Complex* in = &tile[(K[0] - 1) + T[0] * ((Y + K[1] - 1) + T[1] * (Z + K[2] - 1))];
+            double* out = dst + ((P[2] + Z) * S[1] + (P[1] + Y)) * S[0] + P[0];
+            for (Int64 X = 0; X < V[0] && P[0] + X < S[0]; X++)
+              out[X] = in[X].real();
           }
-          #undef ForKernel
-          dst_p[stride[0]*Q[0]]=sum;
         }
-        dst_p+=stride[0]*num_step_x;
-        if (aborted()) return false;
       }
-    }//for each component...
+    });
+  }
+
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct CopyComponentToFloat64Op
+{
+  template<typename SrcType>
+  bool execute(std::vector<double>& dst, Array src, int C)
+  {
+    int ncomponents = src.dtype.ncomponents();
+    const SrcType* src_p = ((const SrcType*)src.c_ptr()) + C;
+    for (Int64 I = 0; I < (Int64)dst.size(); I++)
+      dst[I] = (Float64)src_p[I * ncomponents];
     return true;
   }
 };
 
-Array ArrayUtils::convolve(Array src,Array kernel,Aborted aborted) {
+//ConvolveComponents
+static Array ConvolveComponents(Array src, Convolution& convolution, String method, Aborted aborted)
+{
   Array dst;
-  ConvolveOp op;
-  return ExecuteOnCppSamples(op,src.dtype,dst,src,kernel,aborted)? dst : Array();
+  if (!dst.resize(src.dims, DType(src.dtype.ncomponents(), DTypes::FLOAT64), __FILE__, __LINE__))
+    return Array();
+
+  dst.shareProperties(src);
+
+  //I'm just interested in a "preview"
+  Int64 tot = src.getTotalNumberOfSamples();
+  if (!tot)
+    return dst;
+
+  if (method.empty())
+    method = convolution.guessMethod();
+
+  int ncomponents = src.dtype.ncomponents();
+
+  //single component: no scratch copies, read src (if already Float64) and write dst in place
+  if (ncomponents == 1)
+  {
+    std::vector<double> in;
+    auto src_p = (const Float64*)src.c_ptr();
+    if (src.dtype != DTypes::FLOAT64)
+    {
+      in.resize(tot);
+      CopyComponentToFloat64Op op;
+      if (!ExecuteOnCppSamples(op, src.dtype, in, src, 0))
+        return Array();
+      src_p = &in[0];
+    }
+
+    if (!convolution.run(method, src_p, (Float64*)dst.c_ptr(), aborted))
+      return Array();
+
+    return dst;
+  }
+
+  std::vector<double> in(tot), out(tot);
+  for (int C = 0; C < ncomponents; C++)
+  {
+    CopyComponentToFloat64Op op;
+    if (!ExecuteOnCppSamples(op, src.dtype, in, src, C))
+      return Array();
+
+    if (!convolution.run(method, &in[0], &out[0], aborted))
+      return Array();
+
+    Float64* dst_p = ((Float64*)dst.c_ptr()) + C;
+    for (Int64 I = 0; I < tot; I++)
+      dst_p[I * ncomponents] = out[I];
+  }
+
+  return dst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Array ArrayUtils::convolve(Array src, Array kernel, String method, Aborted aborted)
+{
+  //necessary conditions
+  if (!src.dtype.valid() || !kernel.getTotalNumberOfSamples() || !kernel.dtype.valid() || kernel.dtype.ncomponents() != 1 || src.getPointDim() != kernel.getPointDim())
+  {
+    VisusAssert(aborted());
+    return Array();
+  }
+
+  if (method != "" && method != "direct" && method != "separable" && method != "fft")
+  {
+    PrintWarning("unknown convolution method", method);
+    return Array();
+  }
+
+  kernel = cast(kernel, DTypes::FLOAT64, aborted);
+  if (!kernel.valid())
+    return Array();
+
+  //dimensions (ignore where dims==1 i.e. where memory layout does not change (for example src has dims (1,200,300,1,1)->(200,300))
+  Convolution convolution;
+  int pdim = src.getPointDim(), Kspace = 0;
+  for (int I = 0; I < pdim; I++)
+  {
+    VisusAssert(src.dims[I] >= 1 && kernel.dims[I] >= 1);
+
+    if (src.dims[I] == 1 && kernel.dims[I] == 1)
+      continue;
+
+    if (Kspace == 3 || (kernel.dims[I] % 2) == 0)
+    {
+      VisusAssert(aborted());
+      return Array();
+    }
+
+    convolution.S[Kspace] = src.dims[I];
+    convolution.K[Kspace] = kernel.dims[I];
+    convolution.C[Kspace] = kernel.dims[I] >> 1;
+    Kspace++;
+  }
+
+  if (!Kspace)
+  {
+    VisusAssert(aborted());
+    return Array();
+  }
+
+  auto kernel_p = (const Float64*)kernel.c_ptr();
+  convolution.kernel = std::vector<double>(kernel_p, kernel_p + kernel.getTotalNumberOfSamples());
+
+  //a 1D kernel is trivially separable, but the direct stencil is the same
+  if (Kspace == 1)
+  {
+    if (method == "separable")
+      method = "direct";
+  }
+  else if (method.empty() || method == "separable")
+  {
+    if (!convolution.findSeparableFactors() && method == "separable")
+    {
+      PrintWarning("kernel is not separable");
+      return Array();
+    }
+  }
+
+  return ConvolveComponents(src, convolution, method, aborted);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Array ArrayUtils::convolveSeparable(Array src, std::vector<Array> kernels, Aborted aborted)
+{
+  int pdim = src.getPointDim();
+  if (!src.dtype.valid() || (int)kernels.size() != pdim)
+  {
+    VisusAssert(aborted());
+    return Array();
+  }
+
+  Convolution convolution;
+  int Kspace = 0;
+  double scale = 1.0; //from 1-sample kernels of dimensions that are ignored
+  for (int I = 0; I < pdim; I++)
+  {
+    auto kernel = cast(kernels[I], DTypes::FLOAT64, aborted);
+    Int64 L = kernel.getTotalNumberOfSamples();
+    if (!L || (L % 2) == 0 || kernel.dtype.ncomponents() != 1)
+    {
+      VisusAssert(aborted());
+      return Array();
+    }
+
+    auto kernel_p = (const Float64*)kernel.c_ptr();
+    if (src.dims[I] == 1 && L == 1)
+    {
+      scale *= kernel_p[0];
+      continue;
+    }
+
+    if (Kspace == 3)
+    {
+      VisusAssert(aborted());
+      return Array();
+    }
+
+    convolution.S[Kspace] = src.dims[I];
+    convolution.K[Kspace] = L;
+    convolution.C[Kspace] = L >> 1;
+    convolution.factors[Kspace] = std::vector<double>(kernel_p, kernel_p + L);
+    Kspace++;
+  }
+
+  for (int D = Kspace; D < 3; D++)
+    convolution.factors[D] = { 1.0 };
+
+  for (auto& it : convolution.factors[0])
+    it *= scale;
+
+  return ConvolveComponents(src, convolution, "separable", aborted);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Array ArrayUtils::convolve(Array src, Array kernel, Aborted aborted) {
+  return convolve(src, kernel, "direct", aborted);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -82,6 +82,21 @@ SharedPtr<Encoder> Encoders::createEncoder(String specs) const
   return SharedPtr<Encoder>();
 }
 
+////////////////////////////////////////////////////////////////
+void Encoders::setDictionary(String name, SharedPtr<HeapMemory> value)
+{
+  ScopedLock lock(dictionaries_lock);
+  dictionaries[name] = value;
+}
+
+////////////////////////////////////////////////////////////////
+SharedPtr<HeapMemory> Encoders::getDictionary(String name) const
+{
+  ScopedLock lock(dictionaries_lock);
+  auto it = dictionaries.find(name);
+  return it != dictionaries.end() ? it->second : SharedPtr<HeapMemory>();
+}
+
 
 } //namespace Visus
 
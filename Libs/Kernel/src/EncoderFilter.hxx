@@ -0,0 +1,461 @@
+/*-----------------------------------------------------------------------------
+Copyright(c) 2010 - 2018 ViSUS L.L.C.,
+Scientific Computing and Imaging Institute of the University of Utah
+
+ViSUS L.L.C., 50 W.Broadway, Ste. 300, 84101 - 2044 Salt Lake City, UT
+University of Utah, 72 S Central Campus Dr, Room 3750, 84112 Salt Lake City, UT
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met :
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+For additional information about this project contact : pascucci@acm.org
+For support : support@visus.net
+-----------------------------------------------------------------------------*/
+
+#ifndef VISUS_FILTER_ENCODER_H
+#define VISUS_FILTER_ENCODER_H
+
+#include <Visus/Kernel.h>
+#include <Visus/Encoder.h>
+#include <Visus/StringUtils.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define VISUS_FILTER_ENCODER_SSE2 1
+#  include <emmintrin.h>
+#else
+#  define VISUS_FILTER_ENCODER_SSE2 0
+#endif
+
+namespace Visus {
+
+//////////////////////////////////////////////////////////////
+/*
+Lossless pre-filters applied before a byte-oriented codec (specs examples "shuffle+lz4", "bitshuffle+zip", "delta+shuffle+lz4"):
+
+  - delta:      each sample is replaced by its difference with the previous one of the same component (integer arithmetic on the sample bytes)
+  - shuffle:    bytes are regrouped by significance (all byte 0 of the samples, then all byte 1...), see blosc
+  - bitshuffle: like shuffle, then every byte plane is split into its 8 bit planes
+
+Filters are always applied in the order delta->(bit)shuffle->codec
+*/
+class VISUS_KERNEL_API FilterEncoder : public Encoder
+{
+public:
+
+  VISUS_CLASS(FilterEncoder)
+
+  bool                bDelta = false;
+  String              shuffle; // "" "shuffle" or "bitshuffle"
+  SharedPtr<Encoder>  codec;
+
+  //constructor
+  FilterEncoder(String specs) 
+  {
+    std::vector<String> codec_specs;
+    for (auto it : StringUtils::split(specs, "+"))
+    {
+      if (codec_specs.empty() && it == "delta")
+        bDelta = true;
+
+      else if (codec_specs.empty() && (it == "shuffle" || it == "bitshuffle"))
+        shuffle = it;
+
+      else
+        codec_specs.push_back(it);
+    }
+
+    //example "shuffle" alone means "shuffle+raw"
+    this->codec = Encoders::getSingleton()->createEncoder(StringUtils::join(codec_specs, "+"));
+  }
+
+  //create (null if the codec is unknown or lossy, since filters need the exact bytes back)
+  static SharedPtr<Encoder> create(String specs)
+  {
+    auto ret = std::make_shared<FilterEncoder>(specs);
+    if (!ret->codec || ret->codec->isLossy())
+      return SharedPtr<Encoder>();
+    return ret;
+  }
+
+  //destructor
+  virtual ~FilterEncoder() {
+  }
+
+  //isLossy
+  virtual bool isLossy() const override {
+    return false;
+  }
+
+  //encode
+  virtual SharedPtr<HeapMemory> encode(PointNi dims, DType dtype, SharedPtr<HeapMemory> decoded) override
+  {
+    auto filtered = applyFilters(dtype, decoded);
+    if (!filtered)
+      return SharedPtr<HeapMemory>();
+
+    return codec->encode(dims, dtype, filtered);
+  }
+
+  //decode
+  virtual SharedPtr<HeapMemory> decode(PointNi dims, DType dtype, SharedPtr<HeapMemory> encoded) override
+  {
+    auto filtered = codec->decode(dims, dtype, encoded);
+    if (!filtered)
+      return SharedPtr<HeapMemory>();
+
+    int typesize, stride;
+    getTypeSize(dtype, typesize, stride);
+
+    Int64 nbytes = filtered->c_size();
+    if (!shuffle.empty())
+    {
+      auto decoded = std::make_shared<HeapMemory>();
+      if (!decoded->resize(nbytes, __FILE__, __LINE__))
+        return SharedPtr<HeapMemory>();
+
+      if (shuffle == "shuffle")
+        byteUnshuffle(decoded->c_ptr(), filtered->c_ptr(), nbytes, typesize);
+      else
+        bitUnshuffle(decoded->c_ptr(), filtered->c_ptr(), nbytes, typesize);
+
+      filtered = decoded;
+    }
+
+    if (bDelta)
+    {
+      //IdEncoder returns the same memory
+      if (filtered == encoded)
+        filtered = filtered->clone();
+
+      undelta(filtered->c_ptr(), nbytes, typesize, stride);
+    }
+
+    return filtered;
+  }
+
+  //trainDictionary (the codec sees filtered data)
+  virtual SharedPtr<HeapMemory> trainDictionary(DType dtype, std::vector< SharedPtr<HeapMemory> > samples, Int64 max_size) override
+  {
+    for (auto& it : samples)
+      it = applyFilters(dtype, it);
+    return codec->trainDictionary(dtype, samples, max_size);
+  }
+
+public:
+
+  //applyFilters
+  SharedPtr<HeapMemory> applyFilters(DType dtype, SharedPtr<HeapMemory> decoded) const
+  {
+    if (!decoded)
+      return SharedPtr<HeapMemory>();
+
+    int typesize, stride;
+    getTypeSize(dtype, typesize, stride);
+
+    //never modify the input
+    auto filtered = std::make_shared<HeapMemory>();
+    if (!filtered->resize(decoded->c_size(), __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    const Uint8* src = decoded->c_ptr();
+    Uint8* dst = filtered->c_ptr();
+    Int64 nbytes = decoded->c_size();
+
+    HeapMemory tmp;
+    if (bDelta)
+    {
+      if (shuffle.empty())
+      {
+        delta(dst, src, nbytes, typesize, stride);
+      }
+      else
+      {
+        if (!tmp.resize(nbytes, __FILE__, __LINE__))
+          return SharedPtr<HeapMemory>();
+        delta(tmp.c_ptr(), src, nbytes, typesize, stride);
+        src = tmp.c_ptr();
+      }
+    }
+
+    if (shuffle == "shuffle")
+      byteShuffle(dst, src, nbytes, typesize);
+
+    else if (shuffle == "bitshuffle")
+      bitShuffle(dst, src, nbytes, typesize);
+
+    else if (!bDelta)
+      memcpy(dst, src, (size_t)nbytes);
+
+    return filtered;
+  }
+
+  //getTypeSize (bit-aligned dtypes are handled as bytes)
+  static void getTypeSize(DType dtype, int& typesize, int& stride)
+  {
+    int bitsize = dtype.valid() ? dtype.get(0).getBitSize() : 8;
+    bool bByteAligned = bitsize >= 8 && (bitsize % 8) == 0;
+    typesize = bByteAligned ? bitsize / 8 : 1;
+    stride   = bByteAligned ? dtype.ncomponents() : 1;
+  }
+
+  //delta
+  static void delta(Uint8* dst, const Uint8* src, Int64 nbytes, int typesize, int stride)
+  {
+    switch (typesize)
+    {
+    case 1: return delta<Uint8 >(dst, src, nbytes, stride);
+    case 2: return delta<Uint16>(dst, src, nbytes, stride);
+    case 4: return delta<Uint32>(dst, src, nbytes, stride);
+    case 8: return delta<Uint64>(dst, src, nbytes, stride);
+    default: memcpy(dst, src, (size_t)nbytes); return;
+    }
+  }
+
+  //undelta (in place)
+  static void undelta(Uint8* buffer, Int64 nbytes, int typesize, int stride)
+  {
+    switch (typesize)
+    {
+    case 1: return undelta<Uint8 >(buffer, nbytes, stride);
+    case 2: return undelta<Uint16>(buffer, nbytes, stride);
+    case 4: return undelta<Uint32>(buffer, nbytes, stride);
+    case 8: return undelta<Uint64>(buffer, nbytes, stride);
+    default: return;
+    }
+  }
+
+  //byteShuffle (trailing bytes not multiple of typesize are copied as they are)
+  static void byteShuffle(Uint8* dst, const Uint8* src, Int64 nbytes, int typesize)
+  {
+    if (typesize == 1)
+    {
+      memcpy(dst, src, (size_t)nbytes);
+      return;
+    }
+
+    Int64 N = nbytes / typesize, I = 0;
+
+#if VISUS_FILTER_ENCODER_SSE2
+    if (typesize == 2 || typesize == 4 || typesize == 8)
+    {
+      for (; I + 16 <= N; I += 16)
+      {
+        __m128i v[8];
+        for (int K = 0; K < typesize; K++)
+          v[K] = _mm_loadu_si128((const __m128i*)(src + I * typesize + 16 * K));
+
+        //each round is a rotation by one of the bits of the byte address, after 4 rounds byte K of sample I is at K*16+I
+        for (int R = 0; R < 4; R++)
+          transposeRound(v, typesize);
+
+        for (int K = 0; K < typesize; K++)
+          _mm_storeu_si128((__m128i*)(dst + K * N + I), v[K]);
+      }
+    }
+#endif
+
+    for (; I < N; I++)
+      for (int K = 0; K < typesize; K++)
+        dst[K * N + I] = src[I * typesize + K];
+
+    memcpy(dst + N * typesize, src + N * typesize, (size_t)(nbytes - N * typesize));
+  }
+
+  //byteUnshuffle
+  static void byteUnshuffle(Uint8* dst, const Uint8* src, Int64 nbytes, int typesize)
+  {
+    if (typesize == 1)
+    {
+      memcpy(dst, src, (size_t)nbytes);
+      return;
+    }
+
+    Int64 N = nbytes / typesize, I = 0;
+
+#if VISUS_FILTER_ENCODER_SSE2
+    if (typesize == 2 || typesize == 4 || typesize == 8)
+    {
+      int nrounds = Utils::getLog2(typesize);
+      for (; I + 16 <= N; I += 16)
+      {
+        __m128i v[8];
+        for (int K = 0; K < typesize; K++)
+          v[K] = _mm_loadu_si128((const __m128i*)(src + K * N + I));
+
+        //the inverse rotation is 4+log2(typesize)-4 rounds
+        for (int R = 0; R < nrounds; R++)
+          transposeRound(v, typesize);
+
+        for (int K = 0; K < typesize; K++)
+          _mm_storeu_si128((__m128i*)(dst + I * typesize + 16 * K), v[K]);
+      }
+    }
+#endif
+
+    for (; I < N; I++)
+      for (int K = 0; K < typesize; K++)
+        dst[I * typesize + K] = src[K * N + I];
+
+    memcpy(dst + N * typesize, src + N * typesize, (size_t)(nbytes - N * typesize));
+  }
+
+  //bitShuffle (byte shuffle, then each byte plane of N bytes becomes 8 bit planes of N/8 bytes)
+  static void bitShuffle(Uint8* dst, const Uint8* src, Int64 nbytes, int typesize)
+  {
+    HeapMemory tmp;
+    VisusReleaseAssert(tmp.resize(nbytes, __FILE__, __LINE__));
+    byteShuffle(tmp.c_ptr(), src, nbytes, typesize);
+
+    Int64 N = nbytes / typesize;
+    for (int K = 0; K < typesize; K++)
+      transposeBits(dst + K * N, tmp.c_ptr() + K * N, N);
+
+    memcpy(dst + N * typesize, tmp.c_ptr() + N * typesize, (size_t)(nbytes - N * typesize));
+  }
+
+  //bitUnshuffle
+  static void bitUnshuffle(Uint8* dst, const Uint8* src, Int64 nbytes, int typesize)
+  {
+    HeapMemory tmp;
+    VisusReleaseAssert(tmp.resize(nbytes, __FILE__, __LINE__));
+
+    Int64 N = nbytes / typesize;
+    for (int K = 0; K < typesize; K++)
+      untransposeBits(tmp.c_ptr() + K * N, src + K * N, N);
+
+    memcpy(tmp.c_ptr() + N * typesize, src + N * typesize, (size_t)(nbytes - N * typesize));
+    byteUnshuffle(dst, tmp.c_ptr(), nbytes, typesize);
+  }
+
+private:
+
+  //delta
+  template <typename T>
+  static void delta(Uint8* dst_, const Uint8* src_, Int64 nbytes, int stride)
+  {
+    Int64 N = nbytes / sizeof(T);
+    const T* src = (const T*)src_;
+    T* dst = (T*)dst_;
+    for (Int64 I = 0; I < std::min(N, (Int64)stride); I++)
+      dst[I] = src[I];
+    for (Int64 I = stride; I < N; I++)
+      dst[I] = (T)(src[I] - src[I - stride]);
+    memcpy(dst_ + N * sizeof(T), src_ + N * sizeof(T), (size_t)(nbytes - N * sizeof(T)));
+  }
+
+  //undelta
+  template <typename T>
+  static void undelta(Uint8* buffer, Int64 nbytes, int stride)
+  {
+    Int64 N = nbytes / sizeof(T);
+    T* p = (T*)buffer;
+    for (Int64 I = stride; I < N; I++)
+      p[I] = (T)(p[I] + p[I - stride]);
+  }
+
+#if VISUS_FILTER_ENCODER_SSE2
+
+  //transposeRound (interleave vector K with vector K+typesize/2)
+  static inline void transposeRound(__m128i* v, int typesize)
+  {
+    __m128i t[8];
+    int half = typesize >> 1;
+    for (int K = 0; K < half; K++)
+    {
+      t[2 * K + 0] = _mm_unpacklo_epi8(v[K], v[K + half]);
+      t[2 * K + 1] = _mm_unpackhi_epi8(v[K], v[K + half]);
+    }
+    for (int K = 0; K < typesize; K++)
+      v[K] = t[K];
+  }
+
+#endif
+
+  //transposeBits (bit B of byte I goes to bit I%8 of byte B*N/8+I/8)
+  static void transposeBits(Uint8* dst, const Uint8* src, Int64 N)
+  {
+    Int64 N8 = N / 8, G = 0;
+
+#if VISUS_FILTER_ENCODER_SSE2
+    for (; G + 2 <= N8; G += 2)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + G * 8));
+      for (int B = 7; B >= 0; B--)
+      {
+        Uint16 mask = (Uint16)_mm_movemask_epi8(v);
+        dst[B * N8 + G + 0] = (Uint8)(mask >> 0);
+        dst[B * N8 + G + 1] = (Uint8)(mask >> 8);
+        v = _mm_add_epi8(v, v);
+      }
+    }
+#endif
+
+    for (; G < N8; G++)
+    {
+      for (int B = 0; B < 8; B++)
+      {
+        Uint8 bits = 0;
+        for (int I = 0; I < 8; I++)
+          bits |= (Uint8)(((src[G * 8 + I] >> B) & 1) << I);
+        dst[B * N8 + G] = bits;
+      }
+    }
+
+    memcpy(dst + N8 * 8, src + N8 * 8, (size_t)(N - N8 * 8));
+  }
+
+  //untransposeBits
+  static void untransposeBits(Uint8* dst, const Uint8* src, Int64 N)
+  {
+    //spread[V] has byte I equal to bit I of V
+    static const std::vector<Uint64> spread = []() {
+      std::vector<Uint64> ret(256);
+      for (int V = 0; V < 256; V++)
+        for (int I = 0; I < 8; I++)
+          ret[V] |= (Uint64)((V >> I) & 1) << (8 * I);
+      return ret;
+    }();
+
+    Int64 N8 = N / 8;
+    for (Int64 G = 0; G < N8; G++)
+    {
+      Uint64 value = 0;
+      for (int B = 0; B < 8; B++)
+        value |= spread[src[B * N8 + G]] << B;
+      for (int I = 0; I < 8; I++)
+        dst[G * 8 + I] = (Uint8)(value >> (8 * I));
+    }
+
+    memcpy(dst + N8 * 8, src + N8 * 8, (size_t)(N - N8 * 8));
+  }
+
+};
+
+} //namespace Visus
+
+#endif //VISUS_FILTER_ENCODER_H
+
@@ -0,0 +1,286 @@
+/*-----------------------------------------------------------------------------
+Copyright(c) 2010 - 2018 ViSUS L.L.C.,
+Scientific Computing and Imaging Institute of the University of Utah
+
+ViSUS L.L.C., 50 W.Broadway, Ste. 300, 84101 - 2044 Salt Lake City, UT
+University of Utah, 72 S Central Campus Dr, Room 3750, 84112 Salt Lake City, UT
+
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met :
+
+* Redistributions of source code must retain the above copyright notice, this
+list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+this list of conditions and the following disclaimer in the documentation
+and/or other materials provided with the distribution.
+
+* Neither the name of the copyright holder nor the names of its
+contributors may be used to endorse or promote products derived from
+this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+For additional information about this project contact : pascucci@acm.org
+For support : support@visus.net
+-----------------------------------------------------------------------------*/
+
+#ifndef VISUS_ZSTD_ENCODER_H
+#define VISUS_ZSTD_ENCODER_H
+
+#include <Visus/Kernel.h>
+#include <Visus/Encoder.h>
+#include <Visus/StringUtils.h>
+
+#include <zstd.h>
+#include <zdict.h>
+
+namespace Visus {
+
+//////////////////////////////////////////////////////////////
+/*
+specs examples:
+  "zstd"                  default level
+  "zstd-19"               level 19
+  "zstd-19-dict=<name>"   level 19 with a dictionary registered in Encoders::setDictionary (see IdxDiskAccess)
+
+Frames compressed with a dictionary store its id, decoding checks it
+*/
+class VISUS_KERNEL_API ZstdEncoder : public Encoder
+{
+public:
+
+  VISUS_CLASS(ZstdEncoder)
+
+  int    level = ZSTD_CLEVEL_DEFAULT;
+  String dictionary_name;
+
+  //constructor
+  ZstdEncoder(String specs)
+  {
+    auto options = StringUtils::split(specs, "-");
+    for (auto it : options)
+    {
+      Int64 value;
+      if (StringUtils::tryParse(it, value))
+        level = (int)Utils::clamp(value, (Int64)1, (Int64)ZSTD_maxCLevel());
+
+      else if (StringUtils::startsWith(it, "dict="))
+        dictionary_name = it.substr(5);
+    }
+  }
+
+  //destructor
+  virtual ~ZstdEncoder() {
+  }
+
+  //isLossy
+  virtual bool isLossy() const override {
+    return false;
+  }
+
+  //encode
+  virtual SharedPtr<HeapMemory> encode(PointNi dims, DType dtype, SharedPtr<HeapMemory> decoded) override
+  {
+    if (!decoded)
+      return SharedPtr<HeapMemory>();
+
+    auto encoded = std::make_shared<HeapMemory>();
+    if (!encoded->resize(ZSTD_compressBound((size_t)decoded->c_size()), __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    auto ctx = getCompressionContext();
+    size_t encoded_size;
+    if (auto dictionary = getDictionary())
+    {
+      auto cdict = dictionary->getCompressionDictionary(level);
+      encoded_size = ZSTD_compress_usingCDict(ctx, encoded->c_ptr(), (size_t)encoded->c_size(), decoded->c_ptr(), (size_t)decoded->c_size(), cdict);
+    }
+    else
+    {
+      encoded_size = ZSTD_compressCCtx(ctx, encoded->c_ptr(), (size_t)encoded->c_size(), decoded->c_ptr(), (size_t)decoded->c_size(), level);
+    }
+
+    if (ZSTD_isError(encoded_size))
+    {
+      PrintWarning("zstd compression failed", ZSTD_getErrorName(encoded_size));
+      return SharedPtr<HeapMemory>();
+    }
+
+    if (!encoded->resize(encoded_size, __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    return encoded;
+  }
+
+  //decode
+  virtual SharedPtr<HeapMemory> decode(PointNi dims, DType dtype, SharedPtr<HeapMemory> encoded) override
+  {
+    if (!encoded)
+      return SharedPtr<HeapMemory>();
+
+    auto decoded = std::make_shared<HeapMemory>();
+    if (!decoded->resize(dtype.getByteSize(dims), __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    auto ctx = getDecompressionContext();
+    size_t nbytes;
+    if (auto dictid = ZSTD_getDictID_fromFrame(encoded->c_ptr(), (size_t)encoded->c_size()))
+    {
+      auto dictionary = getDictionary();
+      if (!dictionary || dictionary->id != dictid)
+      {
+        PrintWarning("zstd block needs dictionary", dictid, "which is not available");
+        return SharedPtr<HeapMemory>();
+      }
+      nbytes = ZSTD_decompress_usingDDict(ctx, decoded->c_ptr(), (size_t)decoded->c_size(), encoded->c_ptr(), (size_t)encoded->c_size(), dictionary->getDecompressionDictionary());
+    }
+    else
+    {
+      nbytes = ZSTD_decompressDCtx(ctx, decoded->c_ptr(), (size_t)decoded->c_size(), encoded->c_ptr(), (size_t)encoded->c_size());
+    }
+
+    if (ZSTD_isError(nbytes) || (Int64)nbytes != decoded->c_size()) {
+      VisusAssert(false);
+      return SharedPtr<HeapMemory>();
+    }
+
+    return decoded;
+  }
+
+  //trainDictionary (it's worth it for small blocks, see ZDICT_trainFromBuffer)
+  virtual SharedPtr<HeapMemory> trainDictionary(DType dtype, std::vector< SharedPtr<HeapMemory> > samples, Int64 max_size) override
+  {
+    HeapMemory content;
+    std::vector<size_t> sizes;
+    for (auto it : samples)
+    {
+      if (!it || !it->c_size()) continue;
+      auto offset = content.c_size();
+      if (!content.resize(offset + it->c_size(), __FILE__, __LINE__))
+        return SharedPtr<HeapMemory>();
+      memcpy(content.c_ptr() + offset, it->c_ptr(), (size_t)it->c_size());
+      sizes.push_back((size_t)it->c_size());
+    }
+
+    auto ret = std::make_shared<HeapMemory>();
+    if (sizes.empty() || !ret->resize(max_size, __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    auto size = ZDICT_trainFromBuffer(ret->c_ptr(), (size_t)ret->c_size(), content.c_ptr(), &sizes[0], (unsigned)sizes.size());
+    if (ZDICT_isError(size))
+    {
+      PrintWarning("zstd dictionary training failed", ZDICT_getErrorName(size));
+      return SharedPtr<HeapMemory>();
+    }
+
+    if (!ret->resize(size, __FILE__, __LINE__))
+      return SharedPtr<HeapMemory>();
+
+    return ret;
+  }
+
+private:
+
+  //___________________________________________
+  //digested dictionary, shared by all the encoders using the same one
+  class Dictionary
+  {
+  public:
+
+    SharedPtr<HeapMemory> content;
+    unsigned              id = 0;
+
+    //constructor
+    Dictionary(SharedPtr<HeapMemory> content_) : content(content_) {
+      id = ZDICT_getDictID(content->c_ptr(), (size_t)content->c_size());
+    }
+
+    //destructor
+    ~Dictionary() 
+    {
+      for (auto it : cdicts)
+        ZSTD_freeCDict(it.second);
+
+      if (ddict)
+        ZSTD_freeDDict(ddict);
+    }
+
+    //getCompressionDictionary
+    const ZSTD_CDict* getCompressionDictionary(int level)
+    {
+      ScopedLock lock(this->lock);
+      auto& ret = cdicts[level];
+      if (!ret)
+        ret = ZSTD_createCDict(content->c_ptr(), (size_t)content->c_size(), level);
+      return ret;
+    }
+
+    //getDecompressionDictionary
+    const ZSTD_DDict* getDecompressionDictionary()
+    {
+      ScopedLock lock(this->lock);
+      if (!ddict)
+        ddict = ZSTD_createDDict(content->c_ptr(), (size_t)content->c_size());
+      return ddict;
+    }
+
+  private:
+
+    CriticalSection              lock;
+    std::map<int, ZSTD_CDict*>   cdicts;
+    ZSTD_DDict*                  ddict = nullptr;
+
+  };
+
+  //getDictionary
+  SharedPtr<Dictionary> getDictionary() const
+  {
+    if (dictionary_name.empty())
+      return SharedPtr<Dictionary>();
+
+    auto content = Encoders::getSingleton()->getDictionary(dictionary_name);
+    if (!content)
+      return SharedPtr<Dictionary>();
+
+    //digesting a dictionary is expensive, keep them for the whole process
+    static CriticalSection lock;
+    static std::map<HeapMemory*, SharedPtr<Dictionary> > cache;
+    ScopedLock lock_it(lock);
+    auto& ret = cache[content.get()];
+    if (!ret || ret->content != content)
+      ret = std::make_shared<Dictionary>(content);
+    return ret;
+  }
+
+  //getCompressionContext (one for each thread, contexts can be reused)
+  static ZSTD_CCtx* getCompressionContext() 
+  {
+    static thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> ret(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    return ret.get();
+  }
+
+  //getDecompressionContext
+  static ZSTD_DCtx* getDecompressionContext()
+  {
+    static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> ret(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    return ret.get();
+  }
+
+};
+
+} //namespace Visus
+
+#endif //VISUS_ZSTD_ENCODER_H
+
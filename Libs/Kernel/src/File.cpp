@@ -42,11 +42,206 @@ For support : support@visus.net
 #include <Visus/Time.h>
 #include "osdep.hxx"
 
+#if VISUS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
 
 namespace Visus {
 
 
 
+#if VISUS_IO_URING
+
+/////////////////////////////////////////////////////////////////////////////////////////
+//minimal io_uring ring (raw syscalls, so we don't depend on liburing), only used for batched positional reads
+class IoUring
+{
+public:
+
+  VISUS_NON_COPYABLE_CLASS(IoUring)
+
+  int            fd = -1;
+  unsigned       depth = 0;
+
+  unsigned*      sq_head = nullptr;
+  unsigned*      sq_tail = nullptr;
+  unsigned*      sq_mask = nullptr;
+  unsigned*      sq_array = nullptr;
+  io_uring_sqe*  sqes = nullptr;
+
+  unsigned*      cq_head = nullptr;
+  unsigned*      cq_tail = nullptr;
+  unsigned*      cq_mask = nullptr;
+  io_uring_cqe*  cqes = nullptr;
+
+  void*          sq_ptr = MAP_FAILED; size_t sq_size = 0;
+  void*          cq_ptr = MAP_FAILED; size_t cq_size = 0;
+  void*          sqes_ptr = MAP_FAILED; size_t sqes_size = 0;
+
+  //constructor
+  IoUring(unsigned entries)
+  {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+      return;
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+    bool bSingleMap = (p.features & IORING_FEAT_SINGLE_MMAP) ? true : false;
+    if (bSingleMap)
+      sq_size = cq_size = std::max(sq_size, cq_size);
+
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED)
+      { close(); return; }
+
+    if (!bSingleMap)
+    {
+      cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cq_ptr == MAP_FAILED)
+        { close(); return; }
+    }
+
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED)
+      { close(); return; }
+
+    auto sq = (unsigned char*)sq_ptr;
+    auto cq = (unsigned char*)(bSingleMap ? sq_ptr : cq_ptr);
+
+    sq_head  = (unsigned*)(sq + p.sq_off.head);
+    sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+    sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + p.sq_off.array);
+    sqes     = (io_uring_sqe*)sqes_ptr;
+
+    cq_head  = (unsigned*)(cq + p.cq_off.head);
+    cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+    cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+    cqes     = (io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    depth = p.sq_entries;
+  }
+
+  //destructor
+  ~IoUring() {
+    close();
+  }
+
+  //valid
+  bool valid() const {
+    return depth > 0;
+  }
+
+  //getThreadRing (one ring per thread, so there is no need to lock)
+  static IoUring* getThreadRing()
+  {
+    static std::atomic<bool> disabled(getenv("VISUS_DISABLE_IO_URING") ? true : false);
+    if (disabled)
+      return nullptr;
+
+    static thread_local UniquePtr<IoUring> ring;
+    if (!ring)
+    {
+      ring.reset(new IoUring(256));
+      if (!ring->valid())
+      {
+        //kernel too old, seccomp, ... never try again
+        PrintInfo("io_uring not available, using pread for batched reads");
+        disabled = true;
+        ring.reset();
+        return nullptr;
+      }
+    }
+    return ring.get();
+  }
+
+  //read (mark each request as done by setting `ok`; returns false if the ring is not usable anymore)
+  bool read(int handle, std::vector<File::ReadRequest>& requests, std::function<void(File::ReadRequest&, Int64)> completed)
+  {
+    std::vector<struct iovec> iov(depth);
+
+    for (size_t I = 0; I < requests.size(); I += depth)
+    {
+      auto N = (unsigned)std::min((size_t)depth, requests.size() - I);
+
+      unsigned tail = *sq_tail;
+      for (unsigned J = 0; J < N; J++)
+      {
+        auto& request = requests[I + J];
+        iov[J].iov_base = request.buffer;
+        iov[J].iov_len = (size_t)request.count;
+
+        unsigned index = tail & *sq_mask;
+        auto sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = handle;
+        sqe->off = (__u64)request.pos;
+        sqe->addr = (__u64)(uintptr_t)&iov[J];
+        sqe->len = 1;
+        sqe->user_data = (__u64)(I + J);
+        sq_array[index] = index;
+        tail++;
+      }
+      __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+      unsigned to_submit = N, ndone = 0;
+      while (ndone < N)
+      {
+        int ret = (int)syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0)
+        {
+          if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            continue;
+
+          //nothing in flight, the caller can safely fall back to pread
+          if (to_submit == N && ndone == 0)
+            return false;
+
+          ThrowException("io_uring_enter failed", strerror(errno));
+        }
+        to_submit -= std::min(to_submit, (unsigned)ret);
+
+        unsigned head = *cq_head;
+        unsigned cqtail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != cqtail; head++, ndone++)
+        {
+          auto cqe = &cqes[head & *cq_mask];
+          completed(requests[(size_t)cqe->user_data], (Int64)cqe->res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+      }
+    }
+
+    return true;
+  }
+
+private:
+
+  //close
+  void close()
+  {
+    if (sqes_ptr != MAP_FAILED) munmap(sqes_ptr, sqes_size);
+    if (cq_ptr != MAP_FAILED) munmap(cq_ptr, cq_size);
+    if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+    if (fd >= 0) ::close(fd);
+    sqes_ptr = cq_ptr = sq_ptr = MAP_FAILED;
+    fd = -1;
+    depth = 0;
+  }
+
+};
+
+#endif //VISUS_IO_URING
+
 /////////////////////////////////////////////////////////////////////////////////////////
 class PosixFile : public File::Pimpl
 {
@@ -104,9 +299,15 @@ public:
   //read
   virtual bool read(Int64 pos, Int64 tot, unsigned char* buffer) override;
 
+  //read (batched, all requests in flight at the same time when io_uring is available)
+  virtual bool read(std::vector<File::ReadRequest>& requests) override;
+
   //seek
   bool seek(Int64 value);
 
+  //pread (does not move the cursor)
+  bool pread(Int64 pos, Int64 tot, unsigned char* buffer);
+
   //GetOpenErrorExplanation
   static String GetOpenErrorExplanation();
 
@@ -271,6 +472,88 @@ bool PosixFile::read(Int64 pos, Int64 tot, unsigned char* buffer)
 }
 
 
+/////////////////////////////////////////////////////////////////////
+bool PosixFile::pread(Int64 pos, Int64 tot, unsigned char* buffer)
+{
+  for (Int64 remaining = tot; remaining;)
+  {
+    int chunk = (remaining >= INT_MAX) ? INT_MAX : (int)remaining;
+#if WIN32
+    //should not happen, windows uses Win32File
+    if (!seek(pos)) return false;
+    int n = ::read(this->handle, buffer, chunk);
+    if (n > 0 && this->cursor >= 0) this->cursor += n;
+#else
+    int n = (int)::pread(this->handle, buffer, chunk, (off_t)pos);
+#endif
+    if (n <= 0)
+      return false;
+
+    onReadEvent(n);
+    remaining -= n;
+    buffer += n;
+    pos += n;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+bool PosixFile::read(std::vector<File::ReadRequest>& requests)
+{
+  for (auto& it : requests)
+    it.ok = false;
+
+  if (!isOpen() || !can_read)
+    return false;
+
+  std::vector<File::ReadRequest*> pending;
+  for (auto& it : requests)
+  {
+    if (it.count < 0) continue;
+    if (it.count == 0) it.ok = true; else pending.push_back(&it);
+  }
+
+  if (pending.empty())
+    return std::all_of(requests.begin(), requests.end(), [](const File::ReadRequest& it) {return it.ok; });
+
+#if VISUS_IO_URING
+  if (pending.size() > 1)
+  {
+    if (auto ring = IoUring::getThreadRing())
+    {
+      std::vector<File::ReadRequest> batch;
+      for (auto it : pending)
+        batch.push_back(*it);
+
+      bool bOk = ring->read(this->handle, batch, [&](File::ReadRequest& request, Int64 n)
+      {
+        //the ring could not serve this request (e.g. EINTR/EAGAIN/unsupported), do it synchronously
+        if (n < 0)
+        {
+          request.ok = pread(request.pos, request.count, request.buffer);
+          return;
+        }
+        onReadEvent(n);
+        //short read (i.e. interrupted or >2GiB), complete it synchronously
+        request.ok = (n == request.count) || (n > 0 && pread(request.pos + n, request.count - n, request.buffer + n));
+      });
+
+      if (bOk)
+      {
+        for (size_t I = 0; I < pending.size(); I++)
+          pending[I]->ok = batch[I].ok;
+        return std::all_of(requests.begin(), requests.end(), [](const File::ReadRequest& it) {return it.ok; });
+      }
+    }
+  }
+#endif
+
+  for (auto it : pending)
+    it->ok = pread(it->pos, it->count, it->buffer);
+
+  return std::all_of(requests.begin(), requests.end(), [](const File::ReadRequest& it) {return it.ok; });
+}
+
 /////////////////////////////////////////////////////////////////////
 bool PosixFile::seek(Int64 value)
 {
@@ -908,8 +1191,10 @@ bool FileUtils::touch(Path path)
 
 bool VERBOSE_FILE_LOCK = false;
 
+#if WIN32
+
 /////////////////////////////////////////////////////////////////////////
-void FileUtils::lock(Path path)
+bool FileUtils::lock(Path path, bool bExclusive, Int64 timeout_msec)
 {
   VisusAssert(!path.empty());
   String fullpath=path.toString();
@@ -918,7 +1203,7 @@ void FileUtils::lock(Path path)
 
   String lock_filename=fullpath+ ".lock";
 
-  //let's try a little more
+  //NOTE: on windows there is no reader/writer lock (the lock is always exclusive) 
   Time T1=Time::now();
   Time last_info_time=T1;
   for (int nattempt=0; ;nattempt++)
@@ -931,9 +1216,12 @@ void FileUtils::lock(Path path)
       if (VERBOSE_FILE_LOCK)
         PrintInfo("PID",pid,"got file lock",lock_filename);
 
-      return;
+      return true;
     }
 
+    if (timeout_msec >= 0 && T1.elapsedMsec() >= timeout_msec)
+      return false;
+
     //let the user know that I'm still waiting
     if (last_info_time.elapsedMsec()>1000)
     {
@@ -942,7 +1230,7 @@ void FileUtils::lock(Path path)
       VERBOSE_FILE_LOCK =true;
     }
 
-    Thread::yield();
+    Thread::sleep(std::min(nattempt, 50));
   }
 }
 
@@ -965,6 +1253,167 @@ void FileUtils::unlock(Path path)
 
 }
 
+#else
+
+/////////////////////////////////////////////////////////////////////////
+//OS level locks on a `<filename>.lock` file: the kernel puts waiters to sleep and releases the lock if the process dies.
+//Each lock() opens its own descriptor and uses open file description locks (or flock), so threads of the same process exclude each other too
+class FileLocks
+{
+public:
+
+  //_____________________________________________
+  class Lock
+  {
+  public:
+    int  fd = -1;
+    bool bExclusive = true;
+  };
+
+  CriticalSection                   lock;
+  std::multimap<String, Lock>       locks;
+
+  //singleton
+  static FileLocks* getSingleton() {
+    static FileLocks ret;
+    return &ret;
+  }
+
+  //tryLock
+  static int tryLock(int fd, bool bExclusive, bool bWait)
+  {
+#if defined(F_OFD_SETLKW)
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = bExclusive ? F_WRLCK : F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0; //whole file
+    int ret = ::fcntl(fd, bWait ? F_OFD_SETLKW : F_OFD_SETLK, &fl);
+    if (ret == 0 || errno != EINVAL)
+      return ret;
+    //old kernel without OFD locks, fallback to flock
+#endif
+    return ::flock(fd, (bExclusive ? LOCK_EX : LOCK_SH) | (bWait ? 0 : LOCK_NB));
+  }
+
+  //isSameFile (the lock file could have been removed/recreated by another writer while I was waiting)
+  static bool isSameFile(int fd, String lock_filename)
+  {
+    struct stat a, b;
+    if (::fstat(fd, &a) != 0 || ::stat(lock_filename.c_str(), &b) != 0)
+      return false;
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+  }
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+bool FileUtils::lock(Path path, bool bExclusive, Int64 timeout_msec)
+{
+  VisusAssert(!path.empty());
+  String fullpath=path.toString();
+
+  int pid = Utils::getPid();
+
+  String lock_filename=fullpath+ ".lock";
+
+  Time T1=Time::now();
+  Time last_info_time=T1;
+  for (int nattempt=0; ;nattempt++)
+  {
+    int fd = ::open(lock_filename.c_str(), O_RDWR | O_CREAT | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+    if (fd == -1 && errno == ENOENT)
+    {
+      FileUtils::createDirectory(Path(lock_filename).getParent());
+      fd = ::open(lock_filename.c_str(), O_RDWR | O_CREAT | O_BINARY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+    }
+
+    if (fd == -1)
+      ThrowException("cannot open lock file", lock_filename, strerror(errno));
+
+    //without timeout the kernel puts me to sleep, otherwise I need to poll (with backoff)
+    int ret = -1;
+    while ((ret = FileLocks::tryLock(fd, bExclusive, /*bWait*/timeout_msec < 0)) != 0 && errno == EINTR);
+
+    if (ret == 0 && FileLocks::isSameFile(fd, lock_filename))
+    {
+      auto locks = FileLocks::getSingleton();
+      ScopedLock lock(locks->lock);
+      FileLocks::Lock value;
+      value.fd = fd;
+      value.bExclusive = bExclusive;
+      locks->locks.insert(std::make_pair(fullpath, value));
+
+      if (VERBOSE_FILE_LOCK)
+        PrintInfo("PID", pid, "got file lock", lock_filename, bExclusive ? "exclusive" : "shared");
+
+      return true;
+    }
+
+    ::close(fd);
+
+    //stale lock file (unlinked by the previous owner), just try again
+    if (ret == 0)
+      continue;
+
+    if (errno != EAGAIN && errno != EACCES && errno != EWOULDBLOCK)
+      ThrowException("cannot lock file", lock_filename, strerror(errno));
+
+    if (timeout_msec >= 0 && T1.elapsedMsec() >= timeout_msec)
+      return false;
+
+    //let the user know that I'm still waiting
+    if (last_info_time.elapsedMsec()>1000)
+    {
+      PrintInfo("PID",pid,"waiting for lock on",lock_filename);
+      last_info_time=Time::now();
+      VERBOSE_FILE_LOCK =true;
+    }
+
+    int wait_msec = std::min(1 << std::min(nattempt, 6), 50);
+    if (timeout_msec >= 0)
+      wait_msec = (int)std::max((Int64)1, std::min((Int64)wait_msec, timeout_msec - (Int64)T1.elapsedMsec()));
+    Thread::sleep(wait_msec);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////
+void FileUtils::unlock(Path path)
+{
+  VisusAssert(!path.empty());
+
+  int pid = Utils::getPid();
+
+  String fullpath = path.toString();
+
+  String lock_filename = fullpath + ".lock";
+
+  FileLocks::Lock value;
+  {
+    auto locks = FileLocks::getSingleton();
+    ScopedLock lock(locks->lock);
+    auto it = locks->locks.find(fullpath);
+    if (it == locks->locks.end())
+      ThrowException("file not locked", lock_filename);
+    value = it->second;
+    locks->locks.erase(it);
+  }
+
+  //a writer removes the lock file while still owning the lock (waiters will notice that the file changed, see isSameFile)
+  //readers cannot, since other readers could be still inside
+  if (value.bExclusive)
+    ::unlink(lock_filename.c_str());
+
+  //closing the descriptor releases the lock
+  ::close(value.fd);
+
+  if (VERBOSE_FILE_LOCK)
+    PrintInfo("PID", pid, "released file lock", lock_filename);
+}
+
+#endif
+
 /////////////////////////////////////////////////////////////////////////
 bool FileUtils::copyFile(String src_filename, String dst_filename, bool bFailIfExist)
 {
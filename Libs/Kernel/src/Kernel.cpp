@@ -72,6 +72,11 @@ For support : support@visus.net
 #include "EncoderLz4.hxx"
 #include "EncoderZip.hxx"
 #include "EncoderZfp.hxx"
+#include "EncoderFilter.hxx"
+
+#if VISUS_ZSTD
+#  include "EncoderZstd.hxx"
+#endif
 
 #include "ArrayPluginDevnull.hxx"
 #include "ArrayPluginRawArray.hxx"
@@ -349,6 +354,9 @@ void KernelModule::attach()
 
   NetService::Defaults::proxy = config->readString("Configuration/NetService/proxy");
   NetService::Defaults::proxy_port = cint(config->readString("Configuration/NetService/proxyport"));
+  NetService::Defaults::reuse_connections = config->readBool("Configuration/NetService/reuse_connections", true);
+  NetService::Defaults::keepalive_timeout = config->readInt("Configuration/NetService/keepalive_timeout", 30);
+  NetService::Defaults::dns_cache_timeout = config->readInt("Configuration/NetService/dns_cache_timeout", 300);
 
   NetSocket::Defaults::send_buffer_size = config->readInt("Configuration/NetSocket/send_buffer_size");
   NetSocket::Defaults::recv_buffer_size = config->readInt("Configuration/NetSocket/recv_buffer_size");
@@ -373,6 +381,15 @@ void KernelModule::attach()
     Encoders::getSingleton()->registerEncoder("zip", [](String specs) {return std::make_shared<ZipEncoder>(specs); });
     Encoders::getSingleton()->registerEncoder("zfp", [](String specs) {return std::make_shared<ZfpEncoder>(specs); });
 
+#if VISUS_ZSTD
+    Encoders::getSingleton()->registerEncoder("zstd", [](String specs) {return std::make_shared<ZstdEncoder>(specs); });
+#endif
+
+    //pre-filters, example "shuffle+lz4"
+    Encoders::getSingleton()->registerEncoder("delta",      [](String specs) {return FilterEncoder::create(specs); });
+    Encoders::getSingleton()->registerEncoder("shuffle",    [](String specs) {return FilterEncoder::create(specs); });
+    Encoders::getSingleton()->registerEncoder("bitshuffle", [](String specs) {return FilterEncoder::create(specs); });
+
 #if VISUS_IMAGE
     Encoders::getSingleton()->registerEncoder("png", [](String specs) {return std::make_shared<FreeImageEncoder>(specs); });
     Encoders::getSingleton()->registerEncoder("jpg", [](String specs) {return std::make_shared<FreeImageEncoder>(specs); });
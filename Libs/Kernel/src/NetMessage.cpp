@@ -50,23 +50,30 @@ bool NetMessage::setArrayBody(String compression,Array decoded)
   if (!encoded)
     return false;
 
+  setEncodedArrayBody(compression, decoded.dims, decoded.dtype, decoded.layout, encoded);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////
+void NetMessage::setEncodedArrayBody(String compression, PointNi dims, DType dtype, String layout, SharedPtr<HeapMemory> encoded)
+{
   setHeader("visus-compression"        , compression);
-  setHeader("visus-nsamples"           , decoded.dims.toString());
-  setHeader("visus-dtype"              , decoded.dtype.toString());
-  setHeader("visus-layout"             , decoded.layout);
+  setHeader("visus-nsamples"           , dims.toString());
+  setHeader("visus-dtype"              , dtype.toString());
+  setHeader("visus-layout"             , layout);
   setHeader("Content-Transfer-Encoding", "binary");
 
   if      (compression == "lz4")           setContentType("application/x-lz4");
   else if (compression == "zip")           setContentType("application/zip");
+  else if (StringUtils::startsWith(compression, "zstd")) setContentType("application/zstd");
   else if (compression == "png")           setContentType("image/png");
   else if (compression == "jpg")           setContentType("image/jpeg");
   else if (compression == "tif")           setContentType("image/tiff");
-  else { VisusAssert(compression.empty()); setContentType("application/octet-stream"); }
+  else { VisusAssert(compression.empty() || StringUtils::contains(compression, "+")); setContentType("application/octet-stream"); }
 
   setContentLength(encoded->c_size());
 
   this->body=encoded;
-  return true;
 }
 
 
@@ -104,6 +111,7 @@ bool NetRequest::setHeadersFromString(String headers)
 
   this->url="http://localhost"+path;
   this->method=method;
+  this->protocol=protocol.empty()? "HTTP/1.0" : StringUtils::toUpper(protocol);
 
   for (int i=1;i<(int)v.size();i++)
   {
@@ -39,6 +39,17 @@ For support : support@visus.net
 #include <Visus/NetServer.h>
 #include <Visus/StringTree.h>
 
+#if __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <deque>
+
 namespace Visus {
 
 
@@ -86,16 +97,670 @@ void NetServer::waitForExit() {
 
 
 ///////////////////////////////////////////////////////////////
-bool NetServer::writeResponse(NetSocket* client, NetResponse response)
+void NetServer::prepareResponse(NetResponse& response, bool bKeepAlive)
 {
-  response.setHeader("Connection", "Close");//in this debug version I don't keep the connections alive!
+  if (bKeepAlive)
+  {
+    response.setHeader("Connection", "keep-alive");
+    response.setHeader("Keep-Alive", "timeout=" + cstring(keepalive_timeout_msec / 1000));
+  }
+  else
+  {
+    response.setHeader("Connection", "Close");
+  }
+
+  //with persistent connections the client needs to know where the response ends
+  if (!response.body)
+    response.setContentLength(0);
+
   response.setHeader("NetServer", "Visus debugging server");//just as double check
   response.setHeader("Access-Control-Allow-Origin", "*");//accept connections from localhost
-  client->sendResponse(response);
-  client->shutdownSend();
+}
+
+///////////////////////////////////////////////////////////////
+bool NetServer::writeResponse(NetSocket* client, NetResponse response, bool bKeepAlive)
+{
+  prepareResponse(response, bKeepAlive);
+  bool bOk = client->sendResponse(response);
+
+  if (!bKeepAlive)
+    client->shutdownSend();
+
+  return bOk;
+}
+
+///////////////////////////////////////////////////////////////
+//HTTP/1.1 connections are persistent unless the client closes them, HTTP/1.0 ones only if the client asks for it
+static bool RequestWantsKeepAlive(const NetRequest& request)
+{
+  String connection = StringUtils::toLower(request.getHeader("Connection", request.getHeader("connection")));
+  if (StringUtils::contains(connection, "close"))
+    return false;
+
+  if (request.protocol == "HTTP/1.0")
+    return StringUtils::contains(connection, "keep-alive");
+
   return true;
 }
 
+///////////////////////////////////////////////////////////////
+bool NetServer::handleConnection(SharedPtr<NetSocket> client, bool bFirst)
+{
+  //serve all the requests already received (i.e. HTTP pipelining, responses are sent in order)
+  do
+  {
+    if (bExitThread)
+    {
+      //maybe the client closed the connection
+      writeResponse(client.get(), NetResponse(HttpStatus::STATUS_INTERNAL_SERVER_ERROR), false);
+      return false;
+    }
+
+    NetRequest request = client->receiveRequest();
+    if (!request.valid())
+    {
+      //with keep-alive the client can close the connection at any time
+      if (bFirst)
+        writeResponse(client.get(), NetResponse(HttpStatus::STATUS_BAD_REQUEST), false);
+      return false;
+    }
+    bFirst = false;
+
+    bool bKeepAlive = keepalive_timeout_msec > 0 && RequestWantsKeepAlive(request);
+
+    NetResponse response = module->handleRequest(request);
+    bool bWrote = writeResponse(client.get(), response, bKeepAlive);
+    if (verbose)
+    {
+      if (response.isSuccessful())
+      {
+        if (!bWrote)
+          PrintInfo("Error writing the netresponse to the client, maybe he just dropped the request?");
+        else
+          PrintInfo("Wrote netresponse to the client");
+      }
+      else
+      {
+        PrintInfo("!response.isSuccessful()... skipping it");
+      }
+    }
+
+    if (!bWrote || !bKeepAlive)
+      return false;
+  } 
+  while (client->hasBufferedData());
+
+  return true;
+}
+
+
+#if __linux__
+
+///////////////////////////////////////////////////////////////
+class NetServerReactor
+{
+public:
+
+  VISUS_NON_COPYABLE_CLASS(NetServerReactor)
+
+  //___________________________________________
+  class Output
+  {
+  public:
+    String                headers;
+    SharedPtr<HeapMemory> body;
+    Int64                 sent = 0;
+
+    //size
+    Int64 size() const {
+      return (Int64)headers.size() + (body ? body->c_size() : 0);
+    }
+  };
+
+  //___________________________________________
+  class Connection
+  {
+  public:
+    SharedPtr<NetSocket>  socket;
+    int                   fd = -1;
+    String                input;
+    std::deque<Output>    output;
+    Int64                 output_bytes = 0;
+    int                   events = 0;
+    bool                  bFirst = true;
+    bool                  bBusy = false;     //a request is executing in the compute pool (only one per connection, so that pipelined responses stay in order)
+    bool                  bStalled = false;  //waiting for a free slot in the compute pool
+    bool                  bEOF = false;
+    bool                  bCloseAfterWrite = false;
+    bool                  bClosed = false;
+    Time                  t1 = Time::now();
+  };
+
+  //___________________________________________
+  class Completion
+  {
+  public:
+    SharedPtr<Connection> conn;
+    NetResponse           response;
+    bool                  bKeepAlive = false;
+  };
+
+  //constructor
+  NetServerReactor(NetServer* owner_, SharedPtr<ThreadPool> compute_, int max_jobs_) 
+    : owner(owner_), compute(compute_), max_jobs(max_jobs_) 
+  {
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wakefd;
+    epoll_ctl(epollfd, EPOLL_CTL_ADD, wakefd, &ev);
+  }
+
+  //destructor
+  ~NetServerReactor() 
+  {
+    Thread::join(thread);
+
+    for (auto it : std::map<int, SharedPtr<Connection> >(connections))
+      closeConnection(it.second);
+
+    ::close(wakefd);
+    ::close(epollfd);
+  }
+
+  //valid
+  bool valid() const {
+    return epollfd >= 0 && wakefd >= 0;
+  }
+
+  //start
+  void start(int I) {
+    thread = Thread::start("HttpServer Reactor " + cstring(I), [this]() {
+      entryProc();
+    });
+  }
+
+  //wakeUp
+  void wakeUp() {
+    Uint64 one = 1;
+    if (::write(wakefd, &one, sizeof(one))) {}
+  }
+
+  //addConnection (called by the acceptor thread)
+  void addConnection(SharedPtr<NetSocket> socket)
+  {
+    {
+      ScopedLock lock(this->lock);
+      accepted.push_back(socket);
+    }
+    wakeUp();
+  }
+
+private:
+
+  NetServer*                                owner;
+  SharedPtr<ThreadPool>                     compute;
+  int                                       max_jobs = 1;
+  int                                       njobs = 0;
+  int                                       epollfd = -1;
+  int                                       wakefd = -1;
+  SharedPtr<std::thread>                    thread;
+
+  CriticalSection                           lock;
+  std::vector< SharedPtr<NetSocket> >       accepted;
+  std::vector< Completion >                 completed;
+
+  std::map<int, SharedPtr<Connection> >     connections;
+  std::deque< SharedPtr<Connection> >       stalled;
+
+  //maxInputBytes
+  Int64 maxInputBytes() const {
+    return owner->max_client_bytes + 64 * 1024;
+  }
+
+  //entryProc
+  void entryProc()
+  {
+    Time last_expire = Time::now();
+
+    const int max_events = 256;
+    struct epoll_event events[max_events];
+
+    while (!owner->bExitThread)
+    {
+      int nevents = epoll_wait(epollfd, events, max_events, /*msec*/1000);
+
+      for (int I = 0; I < nevents; I++)
+      {
+        int fd = events[I].data.fd;
+
+        if (fd == wakefd)
+        {
+          Uint64 value;
+          if (::read(wakefd, &value, sizeof(value))) {}
+          continue;
+        }
+
+        auto it = connections.find(fd);
+        if (it == connections.end())
+          continue;
+
+        auto conn = it->second;
+
+        //peer has gone away, nobody is going to read the responses
+        if (events[I].events & (EPOLLHUP | EPOLLERR))
+        {
+          closeConnection(conn);
+          continue;
+        }
+
+        if (events[I].events & (EPOLLIN | EPOLLRDHUP))
+          readInput(conn);
+
+        if (!conn->bClosed && (events[I].events & EPOLLOUT))
+          writeOutput(conn);
+
+        if (!conn->bClosed)
+        {
+          dispatch(conn);
+          updateEvents(conn);
+        }
+      }
+
+      processQueues();
+
+      //close connections idle for too long
+      if (last_expire.elapsedMsec() > 1000)
+      {
+        auto timeout = std::max(1000, owner->keepalive_timeout_msec);
+        std::vector< SharedPtr<Connection> > expired;
+        for (auto it : connections)
+        {
+          auto conn = it.second;
+          if (!conn->bBusy && conn->output.empty() && conn->t1.elapsedMsec() > timeout)
+            expired.push_back(conn);
+        }
+        for (auto conn : expired)
+          closeConnection(conn);
+        last_expire = Time::now();
+      }
+    }
+  }
+
+  //processQueues
+  void processQueues()
+  {
+    std::vector< SharedPtr<NetSocket> > accepted;
+    std::vector< Completion > completed;
+    {
+      ScopedLock lock(this->lock);
+      std::swap(accepted, this->accepted);
+      std::swap(completed, this->completed);
+    }
+
+    for (auto socket : accepted)
+    {
+      auto conn = std::make_shared<Connection>();
+      conn->socket = socket;
+      conn->fd = socket->getDescriptor();
+      fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL, 0) | O_NONBLOCK);
+      connections[conn->fd] = conn;
+
+      struct epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = conn->events = EPOLLIN | EPOLLRDHUP;
+      ev.data.fd = conn->fd;
+      epoll_ctl(epollfd, EPOLL_CTL_ADD, conn->fd, &ev);
+    }
+
+    for (auto& it : completed)
+    {
+      --njobs;
+      auto conn = it.conn;
+      if (conn->bClosed)
+        continue;
+
+      conn->bBusy = false;
+      conn->t1 = Time::now();
+      writeResponse(conn, it.response, it.bKeepAlive);
+      if (conn->bClosed)
+        continue;
+
+      //next pipelined request
+      dispatch(conn);
+      updateEvents(conn);
+    }
+
+    //connections which were waiting for the compute pool
+    while (njobs < max_jobs && !stalled.empty())
+    {
+      auto conn = stalled.front();
+      stalled.pop_front();
+      conn->bStalled = false;
+      if (conn->bClosed)
+        continue;
+      dispatch(conn);
+      updateEvents(conn);
+    }
+  }
+
+  //readInput
+  void readInput(SharedPtr<Connection> conn)
+  {
+    char buffer[64 * 1024];
+    while (!conn->bEOF && (Int64)conn->input.size() < maxInputBytes())
+    {
+      auto n = ::read(conn->fd, buffer, sizeof(buffer));
+
+      if (n > 0)
+      {
+        conn->input.append(buffer, n);
+        conn->t1 = Time::now();
+        continue;
+      }
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+      //peer closed its side (or error), I can still send the responses for the requests already received
+      conn->bEOF = true;
+      if (n < 0)
+        return closeConnection(conn);
+    }
+  }
+
+  //dispatch (parse next request and push it to the compute pool)
+  void dispatch(SharedPtr<Connection> conn)
+  {
+    //backpressure: the client is not consuming its responses
+    if (conn->bClosed || conn->bBusy || conn->bStalled || conn->output_bytes > owner->max_client_bytes)
+      return;
+
+    auto header_end = conn->input.find("\r\n\r\n");
+    if (header_end == String::npos)
+    {
+      if (conn->input.size() > 64 * 1024)
+        return writeResponse(conn, NetResponse(HttpStatus::STATUS_BAD_REQUEST), false);
+
+      if (conn->bEOF)
+      {
+        if (conn->output.empty())
+          closeConnection(conn);
+        else
+          conn->bCloseAfterWrite = true;
+      }
+      return;
+    }
+
+    NetRequest request;
+    bool bOk = false;
+    try
+    {
+      bOk = request.setHeadersFromString(conn->input.substr(0, header_end + 4));
+    }
+    catch (...)
+    {
+      bOk = false;
+    }
+
+    Int64 content_length = bOk ? request.getContentLength() : 0;
+    if (!bOk || content_length < 0 || content_length > owner->max_client_bytes)
+    {
+      //with keep-alive the client can send garbage after the first request, just drop it
+      if (conn->bFirst)
+        return writeResponse(conn, NetResponse(HttpStatus::STATUS_BAD_REQUEST), false);
+      return closeConnection(conn);
+    }
+
+    Int64 request_size = (Int64)header_end + 4 + content_length;
+    if ((Int64)conn->input.size() < request_size)
+    {
+      if (conn->bEOF)
+        closeConnection(conn);
+      return;
+    }
+
+    if (njobs >= max_jobs)
+    {
+      conn->bStalled = true;
+      stalled.push_back(conn);
+      return;
+    }
+
+    if (content_length)
+    {
+      request.body = std::make_shared<HeapMemory>();
+      if (!request.body->resize(content_length, __FILE__, __LINE__))
+        return writeResponse(conn, NetResponse(HttpStatus::STATUS_INTERNAL_SERVER_ERROR), false);
+      memcpy(request.body->c_ptr(), conn->input.c_str() + header_end + 4, content_length);
+    }
+    conn->input.erase(0, request_size);
+
+    bool bKeepAlive = owner->keepalive_timeout_msec > 0 && !conn->bEOF && RequestWantsKeepAlive(request);
+
+    conn->bFirst = false;
+    conn->bBusy = true;
+    ++njobs;
+
+    ThreadPool::push(compute, [this, conn, request, bKeepAlive]()
+    {
+      NetResponse response;
+      try
+      {
+        response = owner->module->handleRequest(request);
+      }
+      catch (std::exception& ex)
+      {
+        response = NetResponse(HttpStatus::STATUS_INTERNAL_SERVER_ERROR, ex.what());
+      }
+
+      Completion completion;
+      completion.conn = conn;
+      completion.response = response;
+      completion.bKeepAlive = bKeepAlive;
+      {
+        ScopedLock lock(this->lock);
+        completed.push_back(completion);
+      }
+      wakeUp();
+    });
+  }
+
+  //writeResponse
+  void writeResponse(SharedPtr<Connection> conn, NetResponse response, bool bKeepAlive)
+  {
+    owner->prepareResponse(response, bKeepAlive);
+
+    if (owner->verbose && !response.isSuccessful())
+      PrintInfo("!response.isSuccessful()", response.status);
+
+    Output output;
+    output.headers = response.getHeadersAsString();
+    if (response.body && response.body->c_size())
+      output.body = response.body;
+
+    conn->output_bytes += output.size();
+    conn->output.push_back(output);
+
+    if (!bKeepAlive)
+      conn->bCloseAfterWrite = true;
+
+    writeOutput(conn);
+  }
+
+  //writeOutput
+  void writeOutput(SharedPtr<Connection> conn)
+  {
+    while (!conn->output.empty())
+    {
+      //gather headers and bodies of the pending responses in one system call
+      struct iovec iov[32];
+      int niov = 0;
+      Int64 skip = conn->output.front().sent;
+      for (auto it = conn->output.begin(); it != conn->output.end() && niov + 2 <= 32; ++it)
+      {
+        std::pair<const Uint8*, Int64> parts[2] = {
+          { (const Uint8*)it->headers.c_str(), (Int64)it->headers.size() },
+          { it->body ? it->body->c_ptr() : nullptr, it->body ? it->body->c_size() : 0 }
+        };
+
+        for (auto part : parts)
+        {
+          Int64 offset = std::min(skip, part.second);
+          skip -= offset;
+          if (part.second - offset <= 0) continue;
+          iov[niov].iov_base = (void*)(part.first + offset);
+          iov[niov].iov_len = (size_t)(part.second - offset);
+          niov++;
+        }
+      }
+
+      auto n = ::writev(conn->fd, iov, niov);
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+
+      if (n < 0)
+      {
+        if (owner->verbose)
+          PrintInfo("Error writing the netresponse to the client, maybe he just dropped the request?");
+        return closeConnection(conn);
+      }
+
+      conn->t1 = Time::now();
+      conn->output_bytes -= n;
+      while (n > 0)
+      {
+        auto& front = conn->output.front();
+        Int64 consumed = std::min((Int64)n, front.size() - front.sent);
+        front.sent += consumed;
+        n -= consumed;
+        if (front.sent == front.size())
+          conn->output.pop_front();
+      }
+    }
+
+    if (conn->bCloseAfterWrite)
+    {
+      conn->socket->shutdownSend();
+      closeConnection(conn);
+    }
+  }
+
+  //updateEvents
+  void updateEvents(SharedPtr<Connection> conn)
+  {
+    if (conn->bClosed)
+      return;
+
+    int events = 0;
+
+    //stop reading from clients which have too many bytes in flight (TCP flow control will slow them down)
+    if (!conn->bEOF && (Int64)conn->input.size() < maxInputBytes() && conn->output_bytes <= owner->max_client_bytes)
+      events |= EPOLLIN | EPOLLRDHUP;
+
+    if (!conn->output.empty())
+      events |= EPOLLOUT;
+
+    if (events == conn->events)
+      return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = conn->events = events;
+    ev.data.fd = conn->fd;
+    epoll_ctl(epollfd, EPOLL_CTL_MOD, conn->fd, &ev);
+  }
+
+  //closeConnection
+  void closeConnection(SharedPtr<Connection> conn)
+  {
+    if (conn->bClosed)
+      return;
+
+    conn->bClosed = true;
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    connections.erase(conn->fd);
+    conn->socket->close();
+    conn->output.clear();
+    conn->output_bytes = 0;
+    conn->input.clear();
+  }
+
+};
+
+///////////////////////////////////////////////////////////////
+void NetServer::runInThisThread()
+{
+  VisusAssert(this->module);
+
+  String url = "http://127.0.0.1:" + cstring(port);
+
+  auto server = std::make_shared<NetSocket>();
+  if (!server->bind(url))
+  {
+    PrintError("NetServer::entryProc bind on port",port,"failed");
+    return;
+  }
+
+  //reactors do the non-blocking network I/O, the compute pool executes the requests
+  int nreactors = this->nreactors > 0 ? this->nreactors : std::max(1, (int)std::thread::hardware_concurrency() / 4);
+  auto compute = std::make_shared<ThreadPool>("HttpServer Worker", nthreads);
+
+  //limit the number of requests queued to the compute pool, other requests wait inside the reactors
+  int max_jobs = std::max(1, 4 * nthreads / nreactors);
+
+  std::vector< SharedPtr<NetServerReactor> > reactors;
+  for (int I = 0; I < nreactors; I++)
+  {
+    auto reactor = std::make_shared<NetServerReactor>(this, compute, max_jobs);
+    if (!reactor->valid())
+    {
+      PrintError("NetServer::entryProc cannot create reactor", strerror(errno));
+      return;
+    }
+    reactors.push_back(reactor);
+  }
+
+  for (int I = 0; I < nreactors; I++)
+    reactors[I]->start(I);
+
+  //loop accept connections
+  for (int next = 0; !bExitThread; )
+  {
+    struct pollfd fds;
+    memset(&fds, 0, sizeof(fds));
+    fds.fd = server->getDescriptor();
+    fds.events = POLLIN;
+    if (poll(&fds, 1, /*msec*/1000) <= 0)
+      continue;
+
+    if (auto client = server->acceptConnection())
+    {
+      reactors[next]->addConnection(client);
+      next = (next + 1) % nreactors;
+    }
+  }
+
+  //reactors must survive the compute pool since jobs post their completions to them
+  this->bExitThread = true;
+  for (auto reactor : reactors)
+    reactor->wakeUp();
+
+  compute->waitAll();
+  reactors.clear();
+  compute.reset();
+}
+
+#else
 
 ///////////////////////////////////////////////////////////////
 void NetServer::runInThisThread()
@@ -114,43 +779,18 @@ void NetServer::runInThisThread()
   auto thread_pool = std::make_shared<ThreadPool>("HttpServer Worker", nthreads);
 
   //loop accept connections/handle operation
+  //NOTE: without epoll a persistent connection keeps its worker until the client closes it or stays idle for the keep-alive timeout
   while (!bExitThread)
   {
     if (auto client = server->acceptConnection())
     {
+      if (keepalive_timeout_msec > 0)
+        client->setReceiveTimeout(keepalive_timeout_msec);
+
       ThreadPool::push(thread_pool,[this, client]()
       {
-        if (bExitThread)
+        for (bool bFirst = true; handleConnection(client, bFirst); bFirst = false)
         {
-          //maybe the client closed the connection
-          writeResponse(client.get(), NetResponse(HttpStatus::STATUS_INTERNAL_SERVER_ERROR));
-        }
-        else
-        {
-          NetRequest request = client->receiveRequest();
-          if (!request.valid())
-          {
-            writeResponse(client.get(), NetResponse(HttpStatus::STATUS_BAD_REQUEST));
-          }
-          else
-          {
-            NetResponse response = module->handleRequest(request);
-            bool bWrote = writeResponse(client.get(), response);
-            if (verbose)
-            {
-              if (response.isSuccessful())
-              {
-                if (!bWrote)
-                  PrintInfo("Error writing the netresponse to the client, maybe he just dropped the request?");
-                else
-                  PrintInfo("Wrote netresponse to the client");
-              }
-              else
-              {
-                PrintInfo("!response.isSuccessful()... skipping it");
-              }
-            }
-          }
         }
       });
     }
@@ -158,6 +798,8 @@ void NetServer::runInThisThread()
   thread_pool.reset();
 }
 
+#endif
+
 //waitForExit
 
 
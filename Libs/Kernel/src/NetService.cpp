@@ -47,6 +47,7 @@ For support : support@visus.net
 #include <thread>
 #include <list>
 #include <set>
+#include <deque>
 
 
 #if VISUS_NET
@@ -57,9 +58,105 @@ namespace Visus {
 
 String NetService::Defaults::proxy="";
 int    NetService::Defaults::proxy_port=0;
+bool   NetService::Defaults::reuse_connections=true;
+int    NetService::Defaults::keepalive_timeout=30;
+int    NetService::Defaults::dns_cache_timeout=300;
 
 ///////////////////////////////////////////////////////////////////////////////////
 #if VISUS_NET
+class CurlPool
+{
+public:
+
+  VISUS_NON_COPYABLE_CLASS(CurlPool)
+
+  //DNS cache and TLS sessions are shared by all easy handles
+  CURLSH*                                  share = nullptr;
+
+  //constructor
+  CurlPool()
+  {
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, LockFunction);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, UnlockFunction);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  }
+
+  //destructor
+  ~CurlPool()
+  {
+    for (auto it : idle)
+      curl_multi_cleanup(it.first);
+    curl_share_cleanup(share);
+  }
+
+  //acquireMulti (the multi handle owns the cache of live connections, so I reuse the most recently released one)
+  CURLM* acquireMulti()
+  {
+    {
+      ScopedLock lock(this->lock);
+      purge();
+      if (!idle.empty())
+      {
+        auto ret = idle.back().first;
+        idle.pop_back();
+        return ret;
+      }
+    }
+    return curl_multi_init();
+  }
+
+  //releaseMulti (keep-alive connections survive the NetService which opened them)
+  void releaseMulti(CURLM* multi)
+  {
+    if (!multi)
+      return;
+
+    if (!NetService::Defaults::reuse_connections)
+    {
+      curl_multi_cleanup(multi);
+      return;
+    }
+
+    ScopedLock lock(this->lock);
+    idle.push_back(std::make_pair(multi, Time::now()));
+    purge();
+  }
+
+private:
+
+  CriticalSection                          lock;
+  CriticalSection                          share_locks[CURL_LOCK_DATA_LAST];
+  std::deque< std::pair<CURLM*, Time> >    idle;
+
+  //purge (idle timeout, and do not keep too many idle pools around)
+  void purge()
+  {
+    const int max_idle = 16;
+    while (!idle.empty() && ((int)idle.size() > max_idle || idle.front().second.elapsedSec() > NetService::Defaults::keepalive_timeout))
+    {
+      curl_multi_cleanup(idle.front().first);
+      idle.pop_front();
+    }
+  }
+
+  //LockFunction
+  static void LockFunction(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    ((CurlPool*)userptr)->share_locks[data].lock();
+  }
+
+  //UnlockFunction
+  static void UnlockFunction(CURL* handle, curl_lock_data data, void* userptr) {
+    ((CurlPool*)userptr)->share_locks[data].unlock();
+  }
+
+};
+
+static CurlPool* curl_pool = nullptr;
+
+///////////////////////////////////////////////////////////////////////////////////
 class CurlConnection
 {
 public:
@@ -70,6 +167,7 @@ public:
   NetResponse                      response;
   bool                             first_byte = false;
   bool                             chunked = false;
+  bool                             retried = false;
 
   CURLM*                           multi_handle;
   CURL*                            handle = nullptr;
@@ -90,6 +188,8 @@ public:
   //destructor
   ~CurlConnection()
   {
+    if (this->request.valid())
+      curl_multi_remove_handle(multi_handle, this->handle);
     if (slist != nullptr) curl_slist_free_all(slist);
     curl_easy_cleanup(handle);
   }
@@ -182,8 +282,24 @@ public:
 
     if (this->request.valid())
     {
-      curl_easy_setopt(this->handle, CURLOPT_FORBID_REUSE, 1L); //not sure if this is the best option (see http://www.perlmonks.org/?node_id=925760)
-      curl_easy_setopt(this->handle, CURLOPT_FRESH_CONNECT, 1L);
+      //persistent connections (live in the multi handle connection cache, see CurlPool)
+      if (NetService::Defaults::reuse_connections)
+      {
+        curl_easy_setopt(this->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+        curl_easy_setopt(this->handle, CURLOPT_MAXAGE_CONN, (long)NetService::Defaults::keepalive_timeout);
+#endif
+      }
+      else
+      {
+        curl_easy_setopt(this->handle, CURLOPT_FORBID_REUSE, 1L);
+        curl_easy_setopt(this->handle, CURLOPT_FRESH_CONNECT, 1L);
+      }
+
+      if (curl_pool)
+        curl_easy_setopt(this->handle, CURLOPT_SHARE, curl_pool->share);
+      curl_easy_setopt(this->handle, CURLOPT_DNS_CACHE_TIMEOUT, (long)NetService::Defaults::dns_cache_timeout);
+
       curl_easy_setopt(this->handle, CURLOPT_NOSIGNAL, 1L); //otherwise crash on linux
       curl_easy_setopt(this->handle, CURLOPT_TCP_NODELAY, 1L);
 
@@ -288,6 +404,33 @@ public:
     }
   }
 
+  //retryOnFreshConnection (a pooled connection can be closed by the server while idle, in this case the request is sent again only once)
+  bool retryOnFreshConnection(CURLcode result)
+  {
+    if (retried || this->response.body || !NetService::Defaults::reuse_connections)
+      return false;
+
+    if (result != CURLE_SEND_ERROR && result != CURLE_RECV_ERROR && result != CURLE_GOT_NOTHING)
+      return false;
+
+    //was a new connection? then it's a real error
+    long num_connects = 0;
+    curl_easy_getinfo(this->handle, CURLINFO_NUM_CONNECTS, &num_connects);
+    if (num_connects > 0)
+      return false;
+
+    this->retried = true;
+    this->response = NetResponse();
+    this->buffer_offset = 0;
+    this->first_byte = false;
+    memset(errbuf, 0, sizeof(errbuf));
+
+    curl_multi_remove_handle(multi_handle, this->handle);
+    curl_easy_setopt(this->handle, CURLOPT_FRESH_CONNECT, 1L);
+    curl_multi_add_handle(multi_handle, this->handle);
+    return true;
+  }
+
   //HeaderFunction
   static size_t HeaderFunction(void *ptr, size_t size, size_t nmemb, CurlConnection *connection)
   {
@@ -398,7 +541,12 @@ public:
   //destructor
   ~Pimpl()
   {
-    if (multi_handle)
+    if (!multi_handle)
+      return;
+
+    if (curl_pool)
+      curl_pool->releaseMulti(multi_handle);
+    else
       curl_multi_cleanup(multi_handle);
   }
 
@@ -422,7 +570,7 @@ public:
 
     //important to create in this thread
     if (!multi_handle)
-      multi_handle = curl_multi_init();
+      multi_handle = curl_pool ? curl_pool->acquireMulti() : curl_multi_init();
 
     return std::make_shared<CurlConnection>(id, multi_handle);
   }
@@ -446,6 +594,9 @@ public:
 
         if (msg->msg == CURLMSG_DONE)
         {
+          if (connection->retryOnFreshConnection(msg->data.result))
+            continue;
+
           long response_code = 0;
           curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
 
@@ -565,6 +716,7 @@ public:
           request->statistics.run_t1 = Time::now();
           connection->first_byte = false;
           connection->chunked=false;
+          connection->retried = false;
           connection->setNetRequest(*request, promise);
         }
         owner->waiting = still_waiting;
@@ -632,12 +784,15 @@ void NetService::attach()
 {
   int retcode = curl_global_init(CURL_GLOBAL_ALL);
   VisusReleaseAssert(retcode == 0);
+  curl_pool = new CurlPool();
 }
 
 
 /////////////////////////////////////////////////////////////////////////////
 void NetService::detach()
 {
+  delete curl_pool;
+  curl_pool = nullptr;
   curl_global_cleanup();
 }
 
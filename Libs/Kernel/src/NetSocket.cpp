@@ -55,7 +55,11 @@ public:
 
   VISUS_NON_COPYABLE_CLASS(Pimpl)
 
-     int socketfd=-1;
+  int socketfd=-1;
+
+  //buffered receive (note: with pipelining the buffer can contain the next requests)
+  std::vector<unsigned char> rbuffer;
+  int rbegin = 0, rend = 0;
 
   //constructor
   Pimpl() {
@@ -78,6 +82,25 @@ public:
     if (socketfd<0) return;
     closesocket(socketfd);
     socketfd = -1;
+    rbegin = rend = 0;
+  }
+
+  //hasBufferedData
+  bool hasBufferedData() const {
+    return rbegin < rend;
+  }
+
+  //setReceiveTimeout
+  void setReceiveTimeout(int msec)
+  {
+#if WIN32
+    DWORD value = (DWORD)std::max(0, msec);
+#else
+    struct timeval value;
+    value.tv_sec = std::max(0, msec) / 1000;
+    value.tv_usec = (std::max(0, msec) % 1000) * 1000;
+#endif
+    setsockopt(this->socketfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&value, sizeof(value));
   }
 
   //shutdownSend
@@ -354,18 +377,50 @@ private:
     if (socketfd<0) 
       return false;
 
+    const int RecvChunk = 64 * 1024;
+
     int flags=0;
 
     while (len)
     {
-      int n = (int)::recv(socketfd, (char*)buf, len, flags);
+      //consume buffered data first
+      if (rbegin < rend)
+      {
+        int n = std::min(len, rend - rbegin);
+        memcpy(buf, &rbuffer[rbegin], n);
+        rbegin += n;
+        buf += n;
+        len -= n;
+        continue;
+      }
+
+      //big reads go directly to the destination, small reads fill the buffer (i.e. no syscall per byte when parsing headers)
+      bool bDirect = len >= RecvChunk;
+      if (!bDirect && rbuffer.empty())
+        rbuffer.resize(RecvChunk);
+
+      int n = bDirect ? 
+        (int)::recv(socketfd, (char*)buf, len, flags) : 
+        (int)::recv(socketfd, (char*)&rbuffer[0], (int)rbuffer.size(), flags);
+
       if (n <= 0)
       {
-        PrintError("Failed to recv data to socket errdescr",getSocketErrorDescription(n));
+        //n==0 is the peer closing the connection (normal with keep-alive), EAGAIN an idle connection hitting the receive timeout
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+          PrintError("Failed to recv data to socket errdescr",getSocketErrorDescription(errno));
         return false;
       }
-      buf += n;
-      len -= n;
+
+      if (bDirect)
+      {
+        buf += n;
+        len -= n;
+      }
+      else
+      {
+        rbegin = 0;
+        rend = n;
+      }
     }
     return true;
   }
@@ -439,6 +494,18 @@ void NetSocket::close() {
   return pimpl->close();
 }
 
+int NetSocket::getDescriptor() const {
+  return pimpl->socketfd;
+}
+
+bool NetSocket::hasBufferedData() const {
+  return pimpl->hasBufferedData();
+}
+
+void NetSocket::setReceiveTimeout(int msec) {
+  return pimpl->setReceiveTimeout(msec);
+}
+
 bool NetSocket::connect(String url) {
   return pimpl->connect(url);
 }
@@ -92,6 +92,7 @@ For support : support@visus.net
 	#include <sys/socket.h>
 	#include <sys/mman.h>
 	#include <sys/stat.h>
+	#include <sys/file.h>
 	#include <sys/sysctl.h>
 	#include <sys/ioctl.h>
 	#include <sys/time.h>
@@ -144,6 +145,7 @@ For support : support@visus.net
 	
 	#include <sys/mman.h>
 	#include <sys/stat.h>
+	#include <sys/file.h>
 	#include <sys/types.h>
 	#include <sys/ioctl.h>
 	#include <sys/time.h>
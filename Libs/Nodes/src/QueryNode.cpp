@@ -133,6 +133,7 @@ public:
       auto query = dataset->createBoxQuery(logic_box, field, time, 'r', this->aborted);
       query->accuracy = this->accuracy;
       query->enableFilters();
+      query->enableInPlaceProgression();
       query->incrementalPublish = [&](Array output) {
         doPublish(output, query);
       };
@@ -14,6 +14,7 @@
 #include <Visus/IdxFile.h>
 #include <Visus/IdxDataset.h>
 #include <Visus/IdxDiskAccess.h>
+#include <Visus/IdxStreamingImporter.h>
 #include <Visus/IdxMultipleDataset.h>
 #include <Visus/GoogleMapsDataset.h>
 #include <Visus/VisusConvert.h>
@@ -80,6 +81,10 @@ def LoadIdxDataset(url):
 }
 %ignore Visus::DbModule::attach;
 
+//GIL (swig is called with -threads, see CMakeLists.txt)
+//every wrapper releases the GIL, so that python threads can overlap dataset IO/decoding (see Samples/python/idx/read_threads.py)
+//C++ code calling back python (see PyMultipleDataset) acquires the GIL again with PyGILState_Ensure
+
 %include <Visus/Db.h>
 %include <Visus/Access.h>
 %include <Visus/LogicSamples.h>
@@ -98,6 +103,7 @@ def LoadIdxDataset(url):
 
 %include <Visus/IdxDataset.h>
 %include <Visus/IdxDiskAccess.h>
+%include <Visus/IdxStreamingImporter.h>
 %include <Visus/IdxMultipleDataset.h>
 %include <Visus/VisusConvert.h>
 
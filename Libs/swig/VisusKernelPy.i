@@ -41,6 +41,8 @@ see https://blog.mbedded.ninja/programming/languages/python/python-swig-bindings
 Normally, you can pass in the -threads argument when calling SWIG to make SWIG release the GIL upon every entry to your C/C++ library from Python
 (or if you are using CMake, call SET_PROPERTY(SOURCE MyInterfaceFile.i PROPERTY SWIG_FLAGS "-threads") ).
 However, this is not the case for any C/C++ class that has been converted into a director.
+
+NOTE: -threads is used (see CMakeLists.txt), every wrapper releases the GIL
 */
 
 
@@ -143,7 +145,7 @@ def __rmul__(self, v):
     return self.__mul__(v)
 
 # ////////////////////////////////////////////////////////
-def toNumPy(src, bShareMem=False, bSqueeze=False):
+def toNumPy(src, bShareMem=False, bSqueeze=False, bReadOnly=False):
 
 	import numpy
 
@@ -178,16 +180,26 @@ def toNumPy(src, bShareMem=False, bSqueeze=False):
 			pass
 
 		holder = MyNumPyHolder()
+
+		# the numpy array (through its base) keeps a reference to the heap memory, so it is safe to use even when the Array is gone
+		if bShareMem:
+			holder.heap = src.heap
 		  
 		holder.__array_interface__ = {
 			'strides': None,
 			'shape': tuple(shape), 
 			'typestr': typestr, 
-			'data': (int(src.c_address()), False),  # The second entry in the tuple is a read-only flag (true means the data area is read-only).
+			'data': (int(src.c_address()), bool(bShareMem and bReadOnly)),  # The second entry in the tuple is a read-only flag (true means the data area is read-only).
 			'version': 3 
 		}
 
-		return numpy.array(holder, copy=False if bShareMem else True) 
+		ret=numpy.array(holder, copy=False if bShareMem else True) 
+
+		# shared memory that other owners (i.e. a RamAccess cache) expect to be immutable
+		if bShareMem and bReadOnly:
+			ret.flags.writeable=False
+
+		return ret
 
 toNumPy = staticmethod(toNumPy)
 
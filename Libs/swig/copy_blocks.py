@@ -49,7 +49,8 @@ class CopyBlocks:
 			# default is to change the layout to rowmajor
 			src.convertBlockQueryToRowMajor(read_block)
 
-			buffer= Array.toNumPy(read_block.buffer, bShareMem=False)
+			# read-only, the block memory can be shared with a cache
+			buffer= Array.toNumPy(read_block.buffer, bShareMem=True, bReadOnly=True)
 
 			# I don't care if it fails????
 			write_ok=dst.writeBlock(read_block.blockid, field=read_block.field.name, time=read_block.time,access=waccess, data=buffer)
@@ -92,6 +92,11 @@ def CreateIdx(**args):
 	if buffer:
 		compression=args["compression"] if "compression" in args else ["zip"]
 		db.compressDataset(compression, buffer)
+
+	# out-of-core (example a generator of numpy slabs along the last axis)
+	elif "slabs" in args:
+		compression=args["compression"] if "compression" in args else ["zip"]
+		db.importSlabs(args["slabs"], compression=compression, max_memory=args.get("max_memory",0))
 			
 	return db
 
@@ -231,7 +236,9 @@ class PyDataset(object):
 		self.executeBlockQueryAndWait(access, read_block)
 		if not read_block.ok(): return None
 		self.db.convertBlockQueryToRowMajor(read_block) # default is to change the layout to rowmajor
-		return Array.toNumPy(read_block.buffer, bShareMem=False)
+		# no copy, the numpy array keeps a reference to the block memory, which can be shared with a cache (i.e. RamAccess): 
+		# it's read-only, use .copy() to modify it
+		return Array.toNumPy(read_block.buffer, bShareMem=True, bReadOnly=True) 
 
 	# writeBlock
 	def writeBlock(self, block_id, time=None, field=None, access=None, data=None, aborted=Aborted()):
@@ -246,7 +253,7 @@ class PyDataset(object):
 		return write_block.ok()
 
 	# read
-	def read(self, logic_box=None, x=None, y=None, z=None, time=None, field=None, num_refinements=1, quality=0, max_resolution=None, disable_filters=False, access=None):
+	def read(self, logic_box=None, x=None, y=None, z=None, time=None, field=None, num_refinements=1, quality=0, max_resolution=None, disable_filters=False, access=None, out=None):
 		"""
 		db=PyDataset.Load(url)
 		
@@ -260,6 +267,9 @@ class PyDataset(object):
 		for data in db.read(z=[512,513],num_refinements=3):
 			print(data)
 
+		# example of reading into a preallocated numpy array (must have the shape/dtype of the result)
+		db.read(z=[512,513], out=data)
+
 		"""
 		
 		pdim=self.getPointDim()
@@ -301,12 +311,30 @@ class PyDataset(object):
 			
 		if not access:
 			access=self.db.createAccess()
+
+		# samples are written directly into the caller numpy array
+		if out is not None:
+			if query.end_resolutions.size()!=1:
+				raise Exception("out is supported only with num_refinements=1")
+			buffer=Array.fromNumPy(out, TargetDim=pdim, bShareMem=True)
+			nsamples=query.getNumberOfSamples()
+			if buffer.dtype.toString()!=field.dtype.toString() or buffer.dims.toVector()!=nsamples.toVector():
+				raise Exception("out has wrong shape/dtype, expecting dims {0} dtype {1}".format(nsamples.toString(), field.dtype.toString()))
+			buffer.fillWithValue(field.default_value)
+			query.buffer=buffer
 			
 		def NoGenerator():
 			if not self.db.executeBoxQuery(access, query):
 				raise Exception("query error {0}".format(query.errormsg))
-			# i cannot be sure how the numpy will be used outside or when the query will dealllocate the buffer
-			data=Array.toNumPy(query.buffer, bShareMem=False) 
+
+			if out is not None:
+				# some queries (e.g. with filters) replace the buffer
+				if query.buffer.c_address()!=buffer.c_address():
+					numpy.copyto(out, Array.toNumPy(query.buffer, bShareMem=True).reshape(out.shape))
+				return out
+
+			# no copy, the numpy array keeps a reference to the query memory
+			data=Array.toNumPy(query.buffer, bShareMem=True) 
 			return data
 			
 		def WithGenerator():
@@ -315,8 +343,8 @@ class PyDataset(object):
 				if not self.db.executeBoxQuery(access, query):
 					raise Exception("query error {0}".format(query.errormsg))
 
-				# i cannot be sure how the numpy will be used outside or when the query will dealllocate the buffer
-				data=Array.toNumPy(query.buffer, bShareMem=False) 
+				# no copy, each level has its own buffer (see Dataset::nextBoxQuery)
+				data=Array.toNumPy(query.buffer, bShareMem=True) 
 				yield data
 				self.db.nextBoxQuery(query)	
 
@@ -424,6 +452,31 @@ class PyDataset(object):
 			data=numpy.stack(slab,axis=0)
 			self.write(data , x=x, y=y, z=z,field=field,time=time, access=access)
 
+	# importSlabs
+	# streaming import of the whole dataset with bounded memory, slabs are along the last axis (i.e. numpy axis 0) and must arrive in order
+	def importSlabs(self, slabs, time=None, field=None, compression=None, max_memory=0):
+
+		pdim=self.getPointDim()
+		field=self.getField(field)
+		time = self.getTime() if time is None else time
+
+		importer=IdxStreamingImporter(self.db, field, time, compression if compression else [])
+		importer.max_memory=max_memory
+		importer.beginImport()
+
+		for slab in slabs:
+			slab=numpy.ascontiguousarray(slab)
+			dims=list(slab.shape)
+			if field.dtype.ncomponents()>1: dims=dims[:-1]
+			nslices=dims[0] if len(dims)==pdim else 1
+			buffer=Array.fromNumPy(slab,bShareMem=True)
+			slab_dims=importer.getSlabDims(nslices)
+			if buffer.c_size()!=field.dtype.getByteSize(slab_dims) or not buffer.resize(slab_dims,field.dtype,__file__,0):
+				raise Exception("slab of shape {0} does not match the slab dims {1} of field {2}".format(slab.shape,slab_dims.toString(),field.name))
+			importer.importSlab(buffer)
+
+		importer.endImport()
+
 	#getXSlice (get a slice orthogonal to the X axis)
 	def getXSlice(self, position=None, resolution=-1,resample_output=True): 
 		"""
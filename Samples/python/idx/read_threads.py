@@ -0,0 +1,132 @@
+## -----------------------------------------------------------------------------
+## Copyright(c) 2010 - 2018 ViSUS L.L.C.,
+## Scientific Computing and Imaging Institute of the University of Utah
+## 
+## ViSUS L.L.C., 50 W.Broadway, Ste. 300, 84101 - 2044 Salt Lake City, UT
+## University of Utah, 72 S Central Campus Dr, Room 3750, 84112 Salt Lake City, UT
+## 
+## All rights reserved.
+## 
+## Redistribution and use in source and binary forms, with or without
+## modification, are permitted provided that the following conditions are met :
+## 
+## * Redistributions of source code must retain the above copyright notice, this
+## list of conditions and the following disclaimer.
+## 
+## * Redistributions in binary form must reproduce the above copyright notice,
+## this list of conditions and the following disclaimer in the documentation
+## and/or other materials provided with the distribution.
+## 
+## * Neither the name of the copyright holder nor the names of its
+## contributors may be used to endorse or promote products derived from
+## this software without specific prior written permission.
+## 
+## THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+## AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+## IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+## DISCLAIMED.IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+## FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+## DAMAGES(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+## SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+## CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+## OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+## OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+## 
+## For additional information about this project contact : pascucci@acm.org
+## For support : support@visus.net
+## -----------------------------------------------------------------------------
+
+import sys
+import os
+import shutil
+import time
+import concurrent.futures
+
+import numpy as np
+
+from OpenVisus import *
+
+"""
+Benchmark of concurrent reads from python threads (the GIL is released during dataset IO/decoding, see VisusDbPy.i)
+
+python Samples/python/idx/read_threads.py [--dims 512,512,256] [--nthreads 1,2,4,8] [--compression zip]
+"""
+
+# ////////////////////////////////////////////////////////////////////////
+def ReadSlices(db, slices):
+	ret=[]
+	for z in slices:
+		ret.append(db.read(z=[z,z+1]))
+	return ret
+
+# ////////////////////////////////////////////////////////////////////////
+def ReadBlocks(db, blocks):
+	ret=0
+	access=db.createAccess()
+	access.beginRead()
+	for blockid in blocks:
+		data=db.readBlock(blockid, access=access)
+		ret+=0 if data is None else data.nbytes
+	access.endRead()
+	return ret
+
+# ////////////////////////////////////////////////////////////////////////
+def RunBenchmark(fn, jobs, nthreads):
+	t1=time.time()
+	if nthreads==1:
+		results=[fn(job) for job in jobs]
+	else:
+		with concurrent.futures.ThreadPoolExecutor(max_workers=nthreads) as executor:
+			results=list(executor.map(fn, jobs))
+	return results, time.time()-t1
+
+# ////////////////////////////////////////////////////////////////////////
+def Main(args):
+
+	dims=(512,512,256)
+	nthreads=[1,2,4,8]
+	compression="zip"
+
+	I=1
+	while I<len(args):
+		if args[I]=="--dims":
+			dims=tuple([int(it) for it in args[I+1].split(",")]); I+=2
+		elif args[I]=="--nthreads":
+			nthreads=[int(it) for it in args[I+1].split(",")]; I+=2
+		elif args[I]=="--compression":
+			compression=args[I+1]; I+=2
+		else:
+			raise Exception("unknown argument {}".format(args[I]))
+
+	width,height,depth=dims
+	data=np.random.randint(0, 256, (depth, height, width), dtype=np.uint16)
+	shutil.rmtree('tmp/read_threads', ignore_errors=True)
+	db=CreateIdx(url='tmp/read_threads/visus.idx', dim=3, dims=dims, fields=[Field("data","uint16")], data=data, compression=[compression])
+
+	# each job is a list of slices/blocks, jobs are distributed among the threads
+	slices=list(range(depth))
+	slice_jobs=[slices[I::64] for I in range(64)]
+
+	nblocks=db.getTotalNumberOfBlocks()
+	blocks=list(range(nblocks))
+	block_jobs=[blocks[I::64] for I in range(64)]
+
+	reference=None
+	for N in nthreads:
+		results,sec=RunBenchmark(lambda job: ReadSlices(db, job), slice_jobs, N)
+		check=np.concatenate([it for job in results for it in job])
+		if reference is None: 
+			reference,reference_sec=check,sec
+		Assert(np.array_equal(reference,check))
+		print("read      nthreads({}) sec({:.2f}) MB/sec({:.1f}) speedup({:.2f})".format(N, sec, data.nbytes/(1024*1024)/sec, reference_sec/sec))
+
+	reference_sec=None
+	for N in nthreads:
+		results,sec=RunBenchmark(lambda job: ReadBlocks(db, job), block_jobs, N)
+		if reference_sec is None: 
+			reference_sec=sec
+		print("readBlock nthreads({}) sec({:.2f}) MB/sec({:.1f}) speedup({:.2f})".format(N, sec, sum(results)/(1024*1024)/sec, reference_sec/sec))
+
+# ////////////////////////////////////////////////////////
+if __name__ == '__main__':
+	Main(sys.argv)